@@ -2,10 +2,70 @@
 #define JSON_H
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
 #include <map>
 #include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <cstdlib>
+#include <charconv>
+#include <cmath>
+#include <ostream>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define JSON_HAS_POSIX
+#endif
+
+#if !defined(JSON_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define JSON_SIMD_AVX2
+#elif !defined(JSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define JSON_SIMD_SSE2
+#endif
+
+// Streaming writers hand their buffer to the stream or file descriptor
+// once it grows past this many bytes.
+#ifndef JSON_WRITER_FLUSH_SIZE
+#define JSON_WRITER_FLUSH_SIZE 65536
+#endif
+
+// Objects with at most this many keys are searched linearly and carry
+// no hash table.
+#ifndef JSON_OBJECT_LINEAR_MAX
+#define JSON_OBJECT_LINEAR_MAX 8
+#endif
+
+// JSON_parallel parses inputs smaller than this on the calling thread.
+#ifndef JSON_PARALLEL_MIN_SIZE
+#define JSON_PARALLEL_MIN_SIZE (1 << 20)
+#endif
+
+// JsonLinesReader pulls its input in blocks of this many bytes.
+#ifndef JSON_LINES_BLOCK_SIZE
+#define JSON_LINES_BLOCK_SIZE (1 << 20)
+#endif
+
+// Containers nested deeper than this fail to parse unless
+// JsonParseOptions::maxDepth says otherwise.
+#ifndef JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH 1024
+#endif
 
 class JsonValue;
 class JsonObject;
@@ -15,23 +75,13 @@ class JsonNumber;
 class JsonBool;
 class JsonNull;
 class JsonData;
+class Json;
 class StringBuffer;
+class JsonKeyPool;
+struct JsonKey;
 
 JsonData *parseToJsonData(StringBuffer &buffer);
 
-static bool parseError = false;
-static std::string parseErrorString = "";
-
-bool hasError()
-{
-    return parseError;
-}
-
-std::string getError()
-{
-    return parseErrorString;
-}
-
 enum class JsonType
 {
     JSON_STRING,
@@ -42,843 +92,5773 @@ enum class JsonType
     JSON_NULL
 };
 
-class StringBuffer
+inline int trailingZeros(uint64_t bits)
 {
-public:
-    inline StringBuffer() : str(""), index(0){};
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
 
-    inline StringBuffer(const std::string &str)
-        : str(str), index(0){};
+// One bit per byte of a 64 byte block, for each character class the
+// structural scanner cares about.
+struct JsonBlockMasks
+{
+    uint64_t quote = 0;
+    uint64_t singleQuote = 0;
+    uint64_t backslash = 0;
+    uint64_t whitespace = 0;
+    uint64_t op = 0;
+};
 
-    inline StringBuffer(const char *str)
-        : str(std::string(str)), index(0)
-    {
-    }
+#if defined(JSON_SIMD_AVX2)
 
-    inline char next()
+inline void classifyBlock(const char *block, JsonBlockMasks &masks)
+{
+    for (int i = 0; i < 2; i++)
     {
-        if (index >= str.length())
-            return '\0';
-        return str[index++];
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32 * i));
+        auto eq = [&](char c)
+        { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); };
+        auto bits = [&](__m256i m)
+        { return (uint64_t)(uint32_t)_mm256_movemask_epi8(m) << (32 * i); };
+
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(eq(' '), eq('\n')), _mm256_or_si256(eq('\t'), eq('\r')));
+        __m256i op = _mm256_or_si256(_mm256_or_si256(eq('{'), eq('}')), _mm256_or_si256(eq('['), eq(']')));
+        op = _mm256_or_si256(op, _mm256_or_si256(eq(':'), eq(',')));
+
+        masks.quote |= bits(eq('"'));
+        masks.singleQuote |= bits(eq('\''));
+        masks.backslash |= bits(eq('\\'));
+        masks.whitespace |= bits(ws);
+        masks.op |= bits(op);
     }
+}
 
-    inline char peek()
+#elif defined(JSON_SIMD_SSE2)
+
+inline void classifyBlock(const char *block, JsonBlockMasks &masks)
+{
+    for (int i = 0; i < 4; i++)
     {
-        if (index >= str.length())
-            return '\0';
-        return str[index];
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+        auto eq = [&](char c)
+        { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); };
+        auto bits = [&](__m128i m)
+        { return (uint64_t)(uint32_t)_mm_movemask_epi8(m) << (16 * i); };
+
+        __m128i ws = _mm_or_si128(_mm_or_si128(eq(' '), eq('\n')), _mm_or_si128(eq('\t'), eq('\r')));
+        __m128i op = _mm_or_si128(_mm_or_si128(eq('{'), eq('}')), _mm_or_si128(eq('['), eq(']')));
+        op = _mm_or_si128(op, _mm_or_si128(eq(':'), eq(',')));
+
+        masks.quote |= bits(eq('"'));
+        masks.singleQuote |= bits(eq('\''));
+        masks.backslash |= bits(eq('\\'));
+        masks.whitespace |= bits(ws);
+        masks.op |= bits(op);
     }
+}
 
-    inline void skipWhitespace()
+#else
+
+inline void classifyBlock(const char *block, JsonBlockMasks &masks)
+{
+    for (int i = 0; i < 64; i++)
     {
-        while (peek() == ' ' || peek() == '\n' || peek() == '\t' || peek() == '\r')
+        uint64_t bit = 1ULL << i;
+        switch (block[i])
         {
-            next();
+        case '"':
+            masks.quote |= bit;
+            break;
+        case '\'':
+            masks.singleQuote |= bit;
+            break;
+        case '\\':
+            masks.backslash |= bit;
+            break;
+        case ' ':
+        case '\n':
+        case '\t':
+        case '\r':
+            masks.whitespace |= bit;
+            break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+            masks.op |= bit;
+            break;
         }
     }
+}
 
-private:
-    const std::string &str;
-    uint index;
-};
-static StringBuffer emptyBuffer;
+#endif
 
-inline bool isWhitespace(char c)
+// Bit i of the result is the xor of bits 0..i of the input, which turns
+// a mask of quotes into a mask of the bytes inside strings.
+inline uint64_t prefixXor(uint64_t bits)
 {
-    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
 }
 
-inline bool isDelimiter(char c)
+// First pass of the parser. Records the position of every structural
+// character, every opening quote and the first byte of every other token
+// outside of strings, 64 bytes at a time. Returns false when the text can
+// not be indexed (single quoted strings, or more than 4GB of input); the
+// parser then scans byte by byte.
+inline bool buildStructuralIndex(const char *str, size_t length, std::vector<uint32_t> &index)
 {
+    index.clear();
 
-    return isWhitespace(c) || c == '}' || c == ']' || c == ',';
-};
-
-inline std::string parseString(StringBuffer &buffer)
-{
+    if (length >= UINT32_MAX)
+        return false;
 
-    parseError = false;
+    index.reserve(length / 4 + 1);
 
-    std::string str = "";
-    char stringEnd;
+    uint64_t prevInString = 0;
+    uint64_t prevEscaped = 0;
+    uint64_t prevSeparator = 1;
+    char tail[64];
 
-    if (buffer.peek() != '"' && buffer.peek() != '\'')
+    for (size_t offset = 0; offset < length; offset += 64)
     {
-        parseError = true;
-        return str;
-    }
+        const char *block = str + offset;
+
+        if (length - offset < 64)
+        {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, length - offset);
+            block = tail;
+        }
 
-    stringEnd = buffer.next();
+        JsonBlockMasks masks;
+        classifyBlock(block, masks);
 
-    while (buffer.peek() != stringEnd && buffer.peek() != '\0')
-    {
-        char next = buffer.next();
+        // A backslash escapes the next byte unless it is escaped itself.
+        // Backslashes are rare enough that walking them one at a time is
+        // cheaper than the branchless carry tricks.
+        uint64_t escaped = 0;
+        uint64_t backslash = masks.backslash;
+
+        if (prevEscaped)
+        {
+            escaped = 1;
+            backslash &= ~1ULL;
+        }
+        prevEscaped = 0;
 
-        if (next == '\\')
+        while (backslash)
         {
-            next = buffer.next();
+            int i = trailingZeros(backslash);
+            backslash &= backslash - 1;
 
-            if (next == '\0')
+            if (i == 63)
             {
-                parseError = true;
-                return str;
+                prevEscaped = 1;
+                break;
             }
 
-            std::string escaped = "\\" + std::string(1, next);
-            str += escaped;
-            continue;
+            escaped |= 1ULL << (i + 1);
+            backslash &= ~(1ULL << (i + 1));
         }
 
-        str += next;
+        uint64_t quote = masks.quote & ~escaped;
+        uint64_t inString = prefixXor(quote) ^ prevInString;
+        prevInString = (uint64_t)((int64_t)inString >> 63);
+
+        if (masks.singleQuote & ~inString)
+            return false;
+
+        uint64_t separator = (masks.op | masks.whitespace) & ~inString;
+        uint64_t scalar = ~(separator | inString);
+        uint64_t structurals = (masks.op & ~inString) | (quote & inString) |
+                               (scalar & ((separator << 1) | prevSeparator));
+        prevSeparator = separator >> 63;
+
+        while (structurals)
+        {
+            index.push_back((uint32_t)(offset + trailingZeros(structurals)));
+            structurals &= structurals - 1;
+        }
     }
 
-    if (buffer.peek() == '\0')
+    return true;
+}
+
+// Returns the first quote or backslash in [p, end), or end.
+inline const char *findQuoteOrBackslash(const char *p, const char *end, char quote)
+{
+#if defined(JSON_SIMD_AVX2)
+    __m256i q = _mm256_set1_epi8(quote);
+    __m256i bs = _mm256_set1_epi8('\\');
+    for (; end - p >= 32; p += 32)
     {
-        parseError = true;
-        return str;
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, bs)));
+        if (bits)
+            return p + trailingZeros(bits);
     }
+#elif defined(JSON_SIMD_SSE2)
+    __m128i q = _mm_set1_epi8(quote);
+    __m128i bs = _mm_set1_epi8('\\');
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs)));
+        if (bits)
+            return p + trailingZeros(bits);
+    }
+#endif
+    while (p < end && *p != quote && *p != '\\')
+        p++;
+    return p;
+}
 
-    buffer.next();
-
-    return str;
+// Returns the first byte in [p, end) that JSON output has to escape: a
+// quote, a backslash or a control character; or end.
+inline const char *findEscapedChar(const char *p, const char *end)
+{
+#if defined(JSON_SIMD_AVX2)
+    __m256i q = _mm256_set1_epi8('"');
+    __m256i bs = _mm256_set1_epi8('\\');
+    __m256i control = _mm256_set1_epi8(0x1F);
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i low = _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control);
+        __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, bs)), low);
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(special);
+        if (bits)
+            return p + trailingZeros(bits);
+    }
+#elif defined(JSON_SIMD_SSE2)
+    __m128i q = _mm_set1_epi8('"');
+    __m128i bs = _mm_set1_epi8('\\');
+    __m128i control = _mm_set1_epi8(0x1F);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i low = _mm_cmpeq_epi8(_mm_max_epu8(v, control), control);
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs)), low);
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(special);
+        if (bits)
+            return p + trailingZeros(bits);
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+        p++;
+    return p;
 }
 
-inline double parseNumber(StringBuffer &buffer)
+// Per lead byte: the length of the sequence it starts (1 for ASCII, 0
+// for bytes that never lead) and the allowed range of the second byte,
+// which is where overlong forms, surrogates and code points past
+// U+10FFFF show up.
+struct JsonUtf8Table
 {
+    unsigned char length[256];
+    unsigned char low[256];
+    unsigned char high[256];
 
-    parseError = false;
+    constexpr JsonUtf8Table() : length(), low(), high()
+    {
+        for (int c = 0; c < 256; c++)
+        {
+            length[c] = c < 0x80 ? 1 : c < 0xC2 ? 0 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : c < 0xF5 ? 4 : 0;
+            low[c] = c < 0x80 ? 0x00 : c == 0xE0 ? 0xA0 : c == 0xF0 ? 0x90 : 0x80;
+            high[c] = c < 0x80 ? 0xFF : c == 0xED ? 0x9F : c == 0xF4 ? 0x8F : 0xBF;
+        }
+    }
+};
 
-    std::string str = "";
+inline constexpr JsonUtf8Table utf8Table;
 
-    bool isNegative = false;
-    bool isDecimal = false;
+// Length of the well formed UTF-8 sequence that starts with the non-ASCII
+// byte at p, or 0 when it is not one.
+inline size_t utf8SequenceLength(const char *p, const char *end)
+{
+    unsigned char c = (unsigned char)*p;
+    size_t length = utf8Table.length[c];
+    if (length < 2 || (size_t)(end - p) < length)
+        return 0;
 
-    if (buffer.peek() == '-')
+    unsigned char second = (unsigned char)p[1];
+    if (second < utf8Table.low[c] || second > utf8Table.high[c])
+        return 0;
+    for (size_t i = 2; i < length; i++)
     {
-        isNegative = true;
-        buffer.next();
+        if (((unsigned char)p[i] & 0xC0) != 0x80)
+            return 0;
     }
+    return length;
+}
 
-    while (!isDelimiter(buffer.peek()) && buffer.peek() != '\0')
+// Returns the start of the first byte sequence in [p, end) that is not
+// well formed UTF-8, or end. Runs of ASCII are skipped a vector at a time.
+inline const char *findInvalidUtf8(const char *p, const char *end)
+{
+    while (p < end)
     {
-        char next = buffer.next();
-
-        if (next == '.')
-        {
-            if (isDecimal)
-            {
-                parseError = true;
-                return 0;
-            }
-            isDecimal = true;
-        }
-
-        str += next;
+#if defined(JSON_SIMD_AVX2)
+        while (end - p >= 32 && _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))) == 0)
+            p += 32;
+#elif defined(JSON_SIMD_SSE2)
+        while (end - p >= 16 && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) == 0)
+            p += 16;
+#endif
+        while (p < end && (unsigned char)*p < 0x80)
+            p++;
+        if (p == end)
+            break;
+
+        size_t length = utf8SequenceLength(p, end);
+        if (length == 0)
+            return p;
+        p += length;
     }
+    return end;
+}
 
-    if (isNegative)
-        return -std::stod(str);
+#if defined(JSON_SIMD_AVX2) || defined(JSON_SIMD_SSE2)
 
-    return std::stod(str);
-}
+// One bit per byte of a vector for each class of byte the UTF-8 check
+// needs. Bytes from 0x80 up are negative as signed chars and keep their
+// order, so signed compares give the ranges.
+struct JsonUtf8Masks
+{
+    uint64_t nonAscii;
+    uint64_t continuation; // 0x80 - 0xBF
+    uint64_t leading3;     // 0xE0 and up
+    uint64_t leading4;     // 0xF0 and up
+    uint64_t invalid;      // 0xC0, 0xC1 and 0xF5 - 0xFF never occur
+    uint64_t e0, ed, f0, f4;
+    uint64_t belowA0; // 0x80 - 0x9F
+    uint64_t below90; // 0x80 - 0x8F
+};
 
-inline bool parseBool(StringBuffer &buffer)
+#if defined(JSON_SIMD_AVX2)
+inline constexpr int utf8BlockSize = 32;
+
+inline void classifyUtf8(const char *block, JsonUtf8Masks &masks)
 {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+    auto below = [&](int c)
+    { return (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8((char)c), v)); };
+    auto eq = [&](int c)
+    { return (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)c))); };
+#else
+inline constexpr int utf8BlockSize = 16;
+
+inline void classifyUtf8(const char *block, JsonUtf8Masks &masks)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+    auto below = [&](int c)
+    { return (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmplt_epi8(v, _mm_set1_epi8((char)c))); };
+    auto eq = [&](int c)
+    { return (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c))); };
+#endif
+    masks.nonAscii = below(0);
+    if (masks.nonAscii == 0)
+        return;
+
+    masks.continuation = below(0xC0);
+    masks.leading3 = masks.nonAscii & ~below(0xE0);
+    masks.leading4 = masks.nonAscii & ~below(0xF0);
+    masks.invalid = (masks.nonAscii & ~masks.continuation & below(0xC2)) | (masks.nonAscii & ~below(0xF5));
+    masks.e0 = eq(0xE0);
+    masks.ed = eq(0xED);
+    masks.f0 = eq(0xF0);
+    masks.f4 = eq(0xF4);
+    masks.belowA0 = below(0xA0);
+    masks.below90 = below(0x90);
+}
 
-    parseError = false;
+#endif
 
-    std::string str = "";
+// Whether [p, end) is well formed UTF-8. With SSE2/AVX2 a vector is
+// checked at once: every lead byte says how many continuation bytes must
+// follow it, and the few leads that narrow the range of the next byte
+// are checked against it. Sequences crossing into the next vector carry
+// over as bits.
+inline bool isValidUtf8(const char *p, const char *end)
+{
+#if defined(JSON_SIMD_AVX2) || defined(JSON_SIMD_SSE2)
+    constexpr int last = utf8BlockSize - 1;
+    constexpr uint64_t all = (1ULL << utf8BlockSize) - 1;
+    uint64_t required = 0; // continuation bytes owed by the vector before
+    uint64_t e0 = 0, ed = 0, f0 = 0, f4 = 0;
 
-    if (buffer.peek() == 't')
+    for (; end - p >= utf8BlockSize; p += utf8BlockSize)
     {
-        str += buffer.next();
-        str += buffer.next();
-        str += buffer.next();
-        str += buffer.next();
-
-        if (!isDelimiter(buffer.peek()) && buffer.peek() != '\0')
+        JsonUtf8Masks m;
+        classifyUtf8(p, m);
+        if (m.nonAscii == 0)
         {
-            parseError = true;
-            parseError =
-                printf("Expected value [true] followed by [delimiter] or ['\\0']. Got [%s] followed by [%c]", str.data(), buffer.peek());
-            return false;
+            if (required)
+                return false;
+            continue;
         }
 
-        if (str == "true")
-            return true;
+        uint64_t leading = m.nonAscii & ~m.continuation;
+        uint64_t errors = (((leading << 1) | (m.leading3 << 2) | (m.leading4 << 3) | required) ^ m.continuation) |
+                          m.invalid | (((m.e0 << 1) | e0) & m.belowA0) | (((m.ed << 1) | ed) & m.continuation & ~m.belowA0) |
+                          (((m.f0 << 1) | f0) & m.below90) | (((m.f4 << 1) | f4) & m.continuation & ~m.below90);
+        if (errors & all)
+            return false;
 
-        parseError = true;
-        parseError = printf("| Expected [true] got [%s]. |", str.data());
-        return false;
+        required = (leading >> last) | (m.leading3 >> (last - 1)) | (m.leading4 >> (last - 2));
+        e0 = m.e0 >> last;
+        ed = m.ed >> last;
+        f0 = m.f0 >> last;
+        f4 = m.f4 >> last;
     }
 
-    if (buffer.peek() == 'f')
+    // The last few bytes go through the scalar check, starting from the
+    // lead of a sequence the last vector left open. The bytes after that
+    // lead were already checked to be continuation bytes.
+    if (required)
+    {
+        while (((unsigned char)p[-1] & 0xC0) == 0x80)
+            p--;
+        p--;
+    }
+#endif
+    return findInvalidUtf8(p, end) == end;
+}
+
+// Returns the first quote, backslash or byte from 0x80 up in [p, end),
+// or end.
+inline const char *findQuoteBackslashOrNonAscii(const char *p, const char *end, char quote)
+{
+#if defined(JSON_SIMD_AVX2)
+    __m256i q = _mm256_set1_epi8(quote);
+    __m256i bs = _mm256_set1_epi8('\\');
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, bs));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(special, v));
+        if (bits)
+            return p + trailingZeros(bits);
+    }
+#elif defined(JSON_SIMD_SSE2)
+    __m128i q = _mm_set1_epi8(quote);
+    __m128i bs = _mm_set1_epi8('\\');
+    for (; end - p >= 16; p += 16)
     {
-        str += buffer.next();
-        str += buffer.next();
-        str += buffer.next();
-        str += buffer.next();
-        str += buffer.next();
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs));
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_or_si128(special, v));
+        if (bits)
+            return p + trailingZeros(bits);
+    }
+#endif
+    while (p < end && *p != quote && *p != '\\' && (unsigned char)*p < 0x80)
+        p++;
+    return p;
+}
+
+// Finds the closing quote like scanString does, checking that everything
+// up to it is well formed UTF-8. ASCII costs the same as the plain scan.
+// Returns the quote, or end when the string is
+// not closed. invalid is set to the start of the first ill-formed
+// sequence, if any.
+inline const char *findStringEndUtf8(const char *begin, const char *end, char quote, bool &hasEscapes,
+                                     const char *&invalid)
+{
+    const char *p = begin;
+    invalid = nullptr;
+    int runs = 0; // of non-ASCII bytes so far
 
-        if (!isDelimiter(buffer.peek()) && buffer.peek() != '\0')
+    for (;;)
+    {
+        p = findQuoteBackslashOrNonAscii(p, end, quote);
+        if (p >= end)
+            return end;
+        if (*p == quote)
+            return p;
+        if (*p == '\\')
         {
-            parseError = true;
-            parseError =
-                printf("| Expected value [false] followed by [delimiter]. Got [%s] followed by [%c]. |", str.data(), buffer.peek());
-            return false;
+            // A non-ASCII escaped byte is invalid JSON, but it is still
+            // checked as UTF-8 like the plain scan would see it.
+            hasEscapes = true;
+            p += p + 1 < end && (unsigned char)p[1] >= 0x80 ? 1 : 2;
+            continue;
         }
 
-        if (str == "false")
-            return false;
+        // A few accented letters are cheapest to check one sequence at a
+        // time before going back to the fast scan.
+        if (++runs <= 4)
+        {
+            do
+            {
+                size_t length = utf8SequenceLength(p, end);
+                if (length == 0)
+                {
+                    invalid = p;
+                    return p;
+                }
+                p += length;
+            } while (p < end && (unsigned char)*p >= 0x80);
+            continue;
+        }
 
-        parseError = true;
-        return false;
+        // Mostly non-ASCII text is checked a vector at a time up to the
+        // next quote or backslash. Neither can continue a sequence, so one
+        // cut short by them is an error here too.
+        const char *stop = findQuoteOrBackslash(p, end, quote);
+        if (!isValidUtf8(p, stop))
+        {
+            // Rare, so the exact start comes from the scalar check.
+            invalid = findInvalidUtf8(p, stop);
+            return stop;
+        }
+        p = stop;
     }
-
-    parseError = true;
-    parseError = printf("| Expected [true] got [%s]. |", str.data());
-    return false;
 }
 
-bool parseNull(StringBuffer &buffer)
+enum class JsonError
 {
+    NONE,
+    INVALID_STRING,
+    INVALID_NUMBER,
+    INVALID_BOOL,
+    INVALID_NULL,
+    INVALID_ARRAY,
+    INVALID_OBJECT,
+    INVALID_CHARACTER,
+    FILE_ERROR,
+    DEPTH_EXCEEDED,
+    INVALID_UTF8
+};
 
-    parseError = false;
-
-    std::string str = "";
+// Outcome of one parse. Every parse carries its own result, so separate
+// threads can parse at the same time.
+struct ParseResult
+{
+    JsonError error = JsonError::NONE;
+    size_t offset = 0; // byte offset of the error in the input
+    size_t line = 0;   // 1-based line and column of the error
+    size_t column = 0;
+    std::string message;
 
-    str += buffer.next();
-    str += buffer.next();
-    str += buffer.next();
-    str += buffer.next();
+    inline bool ok() const
+    {
+        return error == JsonError::NONE;
+    }
 
-    if (!isDelimiter(buffer.peek()) && buffer.peek() != '\0')
+    inline explicit operator bool() const
     {
-        parseError = true;
-        return false;
+        return ok();
     }
+};
 
-    if (str == "null")
-        return true;
+// Result of the last top level parse on the calling thread, for
+// hasError() and getError().
+inline thread_local ParseResult lastParseResult;
 
-    parseError = true;
-    return false;
+inline bool hasError()
+{
+    return !lastParseResult.ok();
 }
 
-class JsonData
+inline std::string getError()
 {
-public:
-    JsonData() {}
+    return lastParseResult.message;
+}
 
-    virtual std::string asString()
-    {
-        return "";
-    };
+inline ParseResult getParseResult()
+{
+    return lastParseResult;
+}
 
-    virtual double asNumber()
-    {
-        return 0;
-    };
+struct JsonParseOptions
+{
+    // Store strings without escapes as views into the parsed text instead
+    // of copying them. The text must outlive the parsed tree.
+    bool zeroCopy = false;
+
+    // Deepest nesting of arrays and objects accepted. Parsing does not
+    // recurse, but destroying and emitting a tree do.
+    size_t maxDepth = JSON_MAX_DEPTH;
+
+    // Reject strings and keys that are not well formed UTF-8, reporting
+    // the offset of the first invalid sequence. LazyJson, which skips
+    // over values unparsed, does not check.
+    bool validateUtf8 = false;
+};
 
-    virtual bool asBool()
+class StringBuffer
+{
+public:
+    inline StringBuffer() : str(""), length(0), index(0){};
+
+    inline StringBuffer(std::string_view str)
+        : str(str.data()), length(str.size()), index(0){};
+
+    inline StringBuffer(std::string_view str, const JsonParseOptions &options,
+                        std::pmr::memory_resource *arena = nullptr, JsonKeyPool *keys = nullptr)
+        : str(str.data()), length(str.size()), index(0), arena(arena), keys(keys), options(options){};
+
+    // Continues in parent's text at start, sharing its structural index
+    // instead of building one. Nodes are heap allocated and keys are not
+    // interned, so the buffer can be used on another thread. depth is the
+    // number of containers already open around start; they count toward
+    // maxDepth.
+    inline StringBuffer(StringBuffer &parent, size_t start, size_t depth = 0)
+        : str(parent.str), length(parent.length), index(start), options(parent.options),
+          structuralData(parent.structuralData), structuralCount(parent.structuralCount), indexed(parent.indexed),
+          depth(depth)
     {
-        return false;
+        if (indexed)
+            cursor = std::lower_bound(structuralData, structuralData + structuralCount, (uint32_t)start) - structuralData;
     };
 
-    virtual JsonObject *asObject()
-    {
-        return nullptr;
-    };
+    StringBuffer(const StringBuffer &) = delete;
+    StringBuffer &operator=(const StringBuffer &) = delete;
 
-    virtual std::vector<JsonData *> *asArray()
+    inline char next()
     {
-        return nullptr;
-    };
+        if (index >= length)
+            return '\0';
+        return str[index++];
+    }
 
-    virtual JsonData *operator[](const std::string &key)
+    inline char peek()
     {
-        return nullptr;
-    };
+        if (index >= length)
+            return '\0';
+        return str[index];
+    }
 
-    virtual JsonData *operator[](int index)
+    inline void skipWhitespace()
     {
-        return nullptr;
-    };
+        if (!indexed)
+        {
+            while (peek() == ' ' || peek() == '\n' || peek() == '\t' || peek() == '\r')
+            {
+                next();
+            }
+            return;
+        }
 
-    virtual JsonData *get(const std::string &key)
-    {
-        return nullptr;
-    };
+        char c = peek();
+        if (c != ' ' && c != '\n' && c != '\t' && c != '\r')
+            return;
 
-    virtual JsonData *get(int index)
-    {
-        return nullptr;
-    };
+        // Whitespace always runs up to the next indexed position.
+        while (cursor < structuralCount && structuralData[cursor] < index)
+            cursor++;
+        index = cursor < structuralCount ? structuralData[cursor] : length;
+    }
 
-    virtual JsonData *set(const std::string &key, JsonData *data)
+    // Runs buildStructuralIndex over the whole text so JSON_parallel can
+    // split it, and skipWhitespace walks the index from then on. Must be
+    // called before parsing. Returns false when the text can not be
+    // indexed.
+    inline bool buildIndex()
     {
-        return nullptr;
-    };
+        indexed = buildStructuralIndex(str, length, structurals);
+        structuralData = structurals.data();
+        structuralCount = indexed ? structurals.size() : 0;
+        cursor = 0;
+        return indexed;
+    }
 
-    virtual JsonData *set(int index, JsonData *data)
+    inline bool isIndexed()
     {
-        return nullptr;
-    };
-
-    virtual void push(JsonData *data){};
+        return indexed;
+    }
 
-    virtual JsonData *pop()
+    // Positions found by buildStructuralIndex, when isIndexed().
+    inline const uint32_t *structuralIndex()
     {
-        return nullptr;
-    };
+        return structuralData;
+    }
 
-    virtual int size()
+    inline size_t structuralIndexSize()
     {
-        return 0;
-    };
+        return structuralCount;
+    }
 
-    virtual JsonType getType()
+    // Records the first error of the parse, at the current position
+    // unless an offset is given. Later errors are ignored.
+    inline void fail(JsonError error, std::string message)
     {
-        return JsonType::JSON_NULL;
-    };
+        fail(error, std::move(message), index);
+    }
 
-    virtual std::string emit()
+    inline void fail(JsonError error, std::string message, size_t offset)
     {
-        return "";
+        if (failed())
+            return;
+
+        result.error = error;
+        result.offset = offset;
+        result.message = std::move(message);
+        result.line = 1;
+
+        size_t lineStart = 0;
+        for (size_t i = 0; i < offset && i < length; i++)
+        {
+            if (str[i] == '\n')
+            {
+                result.line++;
+                lineStart = i + 1;
+            }
+        }
+        result.column = offset - lineStart + 1;
     }
 
-    virtual void operator=(JsonData *data)
+    inline bool failed()
     {
+        return result.error != JsonError::NONE;
     }
 
-    virtual void operator=(std::string str)
+    inline ParseResult &getResult()
     {
+        return result;
     }
 
-    virtual void operator=(double num)
+    inline const char *data()
     {
+        return str;
     }
 
-    virtual void operator=(bool b)
+    inline size_t size()
     {
+        return length;
     }
 
-    virtual ~JsonData(){};
-};
-
-class JsonString : public JsonData
-{
-public:
-    inline JsonString(std::string str) : buffer(emptyBuffer), str(str){};
+    inline size_t position()
+    {
+        return index;
+    }
 
-    inline JsonString(StringBuffer &buffer) : buffer(buffer)
+    inline void seek(size_t position)
     {
-        str = parseString(buffer);
-        if (parseError)
-        {
-            parseErrorString = "Error parsing string";
-        }
-    };
+        index = position < length ? position : length;
+    }
 
-    inline std::string asString() override
+    inline const JsonParseOptions &getOptions()
     {
-        return str;
-    };
+        return options;
+    }
 
-    inline JsonType getType() override
+    // Containers open around the start of this buffer.
+    inline size_t startDepth()
     {
-        return JsonType::JSON_STRING;
-    };
+        return depth;
+    }
 
-    inline void operator=(std::string str) override
+    // Memory resource used for nodes and their containers. Plain heap
+    // allocation unless the buffer was created for a JsonDocument.
+    inline std::pmr::memory_resource *resource()
     {
-        this->str = str;
+        return arena ? arena : std::pmr::new_delete_resource();
     }
 
-    inline std::string emit() override
+    // Pool to intern object keys into, if any.
+    inline JsonKeyPool *keyPool()
     {
-        return "\"" + str + "\"";
+        return keys;
+    }
+
+    template <typename T>
+    inline T *create()
+    {
+        if (arena == nullptr)
+            return new T(*this);
+        return new (arena->allocate(sizeof(T), alignof(T))) T(*this);
     }
 
 private:
-    StringBuffer &buffer;
-    std::string str;
+    const char *str;
+    size_t length;
+    size_t index;
+    std::pmr::memory_resource *arena = nullptr;
+    JsonKeyPool *keys = nullptr;
+    JsonParseOptions options;
+    ParseResult result;
+    std::vector<uint32_t> structurals;
+    const uint32_t *structuralData = nullptr;
+    size_t structuralCount = 0;
+    size_t cursor = 0;
+    bool indexed = false;
+    size_t depth = 0;
 };
 
-class JsonNumber : public JsonData
+inline bool isWhitespace(char c)
 {
-public:
-    inline JsonNumber(double num) : buffer(emptyBuffer), num(num){};
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+inline bool isDelimiter(char c)
+{
+
+    return isWhitespace(c) || c == '}' || c == ']' || c == ',';
+};
 
-    inline JsonNumber(StringBuffer &buffer) : buffer(buffer)
+// Finds the end of the string at the buffer position and moves past it.
+// raw is the text between the quotes, hasEscapes tells whether it
+// contains escape sequences and has to go through decodeString.
+inline bool scanString(StringBuffer &buffer, std::string_view &raw, bool &hasEscapes)
+{
+    hasEscapes = false;
+
+    char stringEnd = buffer.peek();
+
+    if (stringEnd != '"' && stringEnd != '\'')
+        return false;
+
+    const char *begin = buffer.data() + buffer.position() + 1;
+    const char *end = buffer.data() + buffer.size();
+    const char *p = begin;
+
+    if (buffer.getOptions().validateUtf8)
     {
-        num = parseNumber(buffer);
-        if (parseError)
+        const char *invalid;
+        p = findStringEndUtf8(begin, end, stringEnd, hasEscapes, invalid);
+        if (invalid)
         {
-            parseErrorString = "Error parsing number";
+            buffer.fail(JsonError::INVALID_UTF8, "Error parsing string. Invalid UTF-8", invalid - buffer.data());
+            return false;
         }
-    };
+    }
+    else
+    {
+        while ((p = findQuoteOrBackslash(p, end, stringEnd)) < end && *p != stringEnd)
+        {
+            hasEscapes = true;
+            p += 2;
+        }
+    }
 
-    inline double asNumber() override
+    if (p >= end)
     {
-        return num;
-    };
+        buffer.seek(buffer.size());
+        return false;
+    }
 
-    inline JsonType getType() override
+    raw = std::string_view(begin, p - begin);
+    buffer.seek(p + 1 - buffer.data());
+    return true;
+}
+
+inline bool readHex4(const char *p, const char *end, uint32_t &code)
+{
+    if (end - p < 4)
+        return false;
+
+    code = 0;
+    for (int i = 0; i < 4; i++)
     {
-        return JsonType::JSON_NUMBER;
-    };
+        char c = p[i];
+        code <<= 4;
+        if (c >= '0' && c <= '9')
+            code |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            code |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            code |= c - 'A' + 10;
+        else
+            return false;
+    }
+    return true;
+}
 
-    inline void operator=(double num) override
+template <typename String>
+inline void appendUtf8(String &out, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        out.push_back((char)code);
+    }
+    else if (code < 0x800)
     {
-        this->num = num;
+        out.push_back((char)(0xC0 | (code >> 6)));
+        out.push_back((char)(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000)
+    {
+        out.push_back((char)(0xE0 | (code >> 12)));
+        out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (code & 0x3F)));
+    }
+    else
+    {
+        out.push_back((char)(0xF0 | (code >> 18)));
+        out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (code & 0x3F)));
+    }
+}
+
+// Decodes the escape sequences of raw into out in one pass; the runs
+// between backslashes are copied in bulk. \uXXXX becomes UTF-8, with
+// surrogate pairs combined and unpaired surrogates replaced by U+FFFD.
+// Returns false at an invalid escape, with errorOffset its position in
+// raw.
+template <typename String>
+inline bool decodeString(std::string_view raw, String &out, size_t &errorOffset)
+{
+    const char *p = raw.data();
+    const char *end = p + raw.size();
+
+    out.clear();
+    out.reserve(raw.size());
+
+    while (true)
+    {
+        const char *escape = (const char *)memchr(p, '\\', end - p);
+        if (escape == nullptr)
+        {
+            out.append(p, end - p);
+            return true;
+        }
+
+        out.append(p, escape - p);
+        p = escape + 2;
+
+        switch (escape + 1 < end ? escape[1] : '\0')
+        {
+        case '"':
+        case '\\':
+        case '/':
+        case '\'':
+            out.push_back(escape[1]);
+            break;
+        case 'b':
+            out.push_back('\b');
+            break;
+        case 'f':
+            out.push_back('\f');
+            break;
+        case 'n':
+            out.push_back('\n');
+            break;
+        case 'r':
+            out.push_back('\r');
+            break;
+        case 't':
+            out.push_back('\t');
+            break;
+        case 'u':
+        {
+            uint32_t code, low;
+            if (!readHex4(p, end, code))
+            {
+                errorOffset = escape - raw.data();
+                return false;
+            }
+            p += 4;
+
+            if (code >= 0xD800 && code <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+                readHex4(p + 2, end, low) && low >= 0xDC00 && low <= 0xDFFF)
+            {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                p += 6;
+            }
+            else if (code >= 0xD800 && code <= 0xDFFF)
+            {
+                code = 0xFFFD;
+            }
+
+            appendUtf8(out, code);
+            break;
+        }
+        default:
+            errorOffset = escape - raw.data();
+            return false;
+        }
     }
+}
+
+template <typename String>
+inline bool decodeString(std::string_view raw, String &out)
+{
+    size_t errorOffset;
+    return decodeString(raw, out, errorOffset);
+}
+
+// Decodes raw, a string of the buffer's text, and records an invalid
+// escape as a parse error at its position.
+template <typename String>
+inline bool decodeString(StringBuffer &buffer, std::string_view raw, String &out)
+{
+    size_t errorOffset;
+    if (decodeString(raw, out, errorOffset))
+        return true;
+
+    buffer.fail(JsonError::INVALID_STRING, "Error parsing string. Invalid escape sequence",
+                raw.data() - buffer.data() + errorOffset);
+    return false;
+}
+
+inline std::string parseString(StringBuffer &buffer)
+{
+
+    std::string str = "";
+    std::string_view raw;
+    bool hasEscapes;
+    size_t start = buffer.position();
 
-    inline std::string emit() override
+    if (!scanString(buffer, raw, hasEscapes))
     {
-        return std::to_string(num);
+        buffer.fail(JsonError::INVALID_STRING, "Error parsing string", start);
+        return str;
     }
 
-private:
-    StringBuffer &buffer;
-    double num;
+    decodeString(buffer, raw, str);
+    return str;
+}
+
+struct JsonNumberToken
+{
+    bool isInteger = true;
+    bool isNegative = false;
+    uint64_t integer = 0; // magnitude when isInteger
+    double real = 0;
+
+    inline double toDouble() const
+    {
+        if (!isInteger)
+            return real;
+        return isNegative ? -(double)integer : (double)integer;
+    }
 };
 
-class JsonBool : public JsonData
+inline bool isDigit(char c)
 {
-public:
-    inline JsonBool(bool b) : buffer(emptyBuffer), b(b){};
+    return (unsigned char)(c - '0') < 10;
+}
+
+// Parses the number at the buffer position directly from the text.
+// Integers of up to 19 digits are accumulated exactly, anything with a
+// fraction, an exponent or more digits goes through std::from_chars,
+// which is locale independent and correctly rounded.
+inline bool parseNumberToken(StringBuffer &buffer, JsonNumberToken &number)
+{
+    const char *begin = buffer.data() + buffer.position();
+    const char *end = buffer.data() + buffer.size();
+    const char *p = begin;
 
-    inline JsonBool(StringBuffer &buffer) : buffer(buffer)
+    number = JsonNumberToken();
+
+    if (p < end && *p == '-')
     {
-        b = parseBool(buffer);
-        if (parseError)
+        number.isNegative = true;
+        p++;
+    }
+
+    const char *digits = p;
+    uint64_t value = 0;
+
+    while (p < end && isDigit(*p))
+    {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+
+    size_t digitCount = p - digits;
+    if (digitCount == 0)
+        return false;
+
+    if (p < end && *p == '.')
+    {
+        number.isInteger = false;
+        const char *fraction = ++p;
+        while (p < end && isDigit(*p))
+            p++;
+        if (p == fraction)
+            return false;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        number.isInteger = false;
+        if (++p < end && (*p == '+' || *p == '-'))
+            p++;
+        const char *exponent = p;
+        while (p < end && isDigit(*p))
+            p++;
+        if (p == exponent)
+            return false;
+    }
+
+    if (p < end && !isDelimiter(*p))
+        return false;
+
+    if (number.isInteger)
+    {
+        if (digitCount <= 19)
         {
-            parseErrorString = printf("| Error parsing bool. Reason: %s. |", parseErrorString.data());
+            number.integer = value;
+            buffer.seek(p - buffer.data());
+            return true;
         }
-    };
 
-    inline bool asBool() override
+        auto result = std::from_chars(digits, p, number.integer);
+        if (result.ec == std::errc())
+        {
+            buffer.seek(p - buffer.data());
+            return true;
+        }
+
+        number.isInteger = false;
+    }
+
+    auto result = std::from_chars(begin, p, number.real);
+    if (result.ec == std::errc::result_out_of_range)
     {
-        return b;
-    };
+        // Overflow to infinity or underflow to zero, which from_chars
+        // reports without a value.
+        number.real = std::strtod(std::string(begin, p).c_str(), nullptr);
+    }
+    else if (result.ec != std::errc())
+    {
+        return false;
+    }
 
-    inline JsonType getType() override
+    buffer.seek(p - buffer.data());
+    return true;
+}
+
+inline double parseNumber(StringBuffer &buffer)
+{
+
+    JsonNumberToken number;
+
+    if (!parseNumberToken(buffer, number))
     {
-        return JsonType::JSON_BOOL;
-    };
+        buffer.fail(JsonError::INVALID_NUMBER, "Error parsing number");
+        return 0;
+    }
 
-    inline void operator=(bool b) override
+    return number.toDouble();
+}
+
+// Matches the literal at the buffer position, which has to be followed
+// by a delimiter or the end of the input.
+inline bool parseLiteral(StringBuffer &buffer, std::string_view literal)
+{
+    size_t left = buffer.size() - buffer.position();
+    std::string_view text(buffer.data() + buffer.position(), left < literal.size() ? left : literal.size());
+
+    if (text != literal)
+        return false;
+
+    buffer.seek(buffer.position() + literal.size());
+    return isDelimiter(buffer.peek()) || buffer.peek() == '\0';
+}
+
+inline bool parseBool(StringBuffer &buffer)
+{
+
+    size_t start = buffer.position();
+    bool value = buffer.peek() == 't';
+    std::string_view expected = value ? "true" : "false";
+
+    if ((buffer.peek() != 't' && buffer.peek() != 'f') || !parseLiteral(buffer, expected))
     {
-        this->b = b;
+        buffer.fail(JsonError::INVALID_BOOL, "Error parsing bool. Expected [" + std::string(expected) + "] followed by a delimiter", start);
+        return false;
+    }
+
+    return value;
+}
+
+inline bool parseNull(StringBuffer &buffer)
+{
+
+    size_t start = buffer.position();
+
+    if (!parseLiteral(buffer, "null"))
+    {
+        buffer.fail(JsonError::INVALID_NULL, "Error parsing null. Expected [null] followed by a delimiter", start);
+        return false;
+    }
+
+    return true;
+}
+
+// Output for JsonData::emit. Appends into one growable buffer; when
+// created for a stream or file descriptor the buffer is flushed every
+// JSON_WRITER_FLUSH_SIZE bytes, so memory use does not depend on the
+// size of the document.
+class JsonWriter
+{
+public:
+    inline JsonWriter() : stream(nullptr), fd(-1), length(0){};
+
+    inline JsonWriter(std::ostream &stream) : stream(&stream), fd(-1), length(0){};
+
+#ifdef JSON_HAS_POSIX
+    inline JsonWriter(int fd) : stream(nullptr), fd(fd), length(0){};
+#endif
+
+    JsonWriter(const JsonWriter &) = delete;
+    JsonWriter &operator=(const JsonWriter &) = delete;
+
+    inline ~JsonWriter()
+    {
+        flush();
+    }
+
+    inline void put(char c)
+    {
+        if (length == buffer.size())
+            grow(1);
+        buffer[length++] = c;
+        if (length >= JSON_WRITER_FLUSH_SIZE)
+            flushIfStreaming();
+    }
+
+    inline void write(const char *data, size_t size)
+    {
+        if (length + size > buffer.size())
+            grow(size);
+        memcpy(&buffer[length], data, size);
+        length += size;
+        if (length >= JSON_WRITER_FLUSH_SIZE)
+            flushIfStreaming();
+    }
+
+    inline void write(std::string_view str)
+    {
+        write(str.data(), str.size());
+    }
+
+    // Returns space for at least size bytes at the end of the buffer.
+    // Call commit with the end of what was written into it.
+    inline char *reserve(size_t size)
+    {
+        if (length + size > buffer.size())
+            grow(size);
+        return &buffer[length];
+    }
+
+    inline void commit(char *end)
+    {
+        length = end - buffer.data();
+        if (length >= JSON_WRITER_FLUSH_SIZE)
+            flushIfStreaming();
+    }
+
+    // Moves the output out of a writer that has no stream or descriptor.
+    inline std::string take()
+    {
+        buffer.resize(length);
+        length = 0;
+        return std::move(buffer);
     }
 
-    inline std::string emit() override
+    inline void flush()
     {
-        if (b)
-            return "true";
-        return "false";
+        if (length == 0 || (stream == nullptr && fd < 0))
+            return;
+
+        if (stream)
+        {
+            stream->write(buffer.data(), length);
+            failed |= !stream->good();
+        }
+#ifdef JSON_HAS_POSIX
+        else
+        {
+            const char *p = buffer.data();
+            size_t left = length;
+            while (left > 0)
+            {
+                ssize_t written = ::write(fd, p, left);
+                if (written < 0)
+                {
+                    failed = true;
+                    break;
+                }
+                p += written;
+                left -= written;
+            }
+        }
+#endif
+        length = 0;
+    }
+
+    inline bool good()
+    {
+        return !failed;
     }
 
 private:
-    StringBuffer &buffer;
-    bool b;
+    inline void grow(size_t size)
+    {
+        size_t capacity = buffer.size() * 2;
+        if (capacity < length + size)
+            capacity = length + size;
+        if (capacity < 256)
+            capacity = 256;
+        buffer.resize(capacity);
+    }
+
+    inline void flushIfStreaming()
+    {
+        if (stream || fd >= 0)
+            flush();
+    }
+
+    std::ostream *stream;
+    int fd;
+    std::string buffer;
+    size_t length;
+    bool failed = false;
 };
 
-class JsonNull : public JsonData
+// Doubles are written in the shortest form that parses back to the
+// same value. JSON has no NaN or infinity, those are written as null.
+template <typename Number>
+inline void writeNumber(JsonWriter &writer, Number value)
+{
+    if constexpr (std::is_floating_point_v<Number>)
+    {
+        if (!std::isfinite(value))
+        {
+            writer.write("null");
+            return;
+        }
+    }
+
+    char *out = writer.reserve(32);
+    writer.commit(std::to_chars(out, out + 32, value).ptr);
+}
+
+// Writes value as a quoted JSON string. Only quotes, backslashes and
+// control characters are escaped; the runs between them are written in
+// bulk.
+inline void writeString(JsonWriter &writer, std::string_view value)
 {
+    static const char hex[] = "0123456789abcdef";
 
-public:
-    inline JsonNull() : buffer(emptyBuffer){};
+    const char *p = value.data();
+    const char *end = p + value.size();
 
-    inline JsonNull(StringBuffer &buffer) : buffer(buffer)
+    writer.put('"');
+
+    while (true)
     {
-        if (!parseNull(buffer))
+        const char *special = findEscapedChar(p, end);
+        writer.write(std::string_view(p, special - p));
+        if (special == end)
+            break;
+
+        switch (*special)
         {
-            parseError = true;
-            parseErrorString = "Error parsing null";
+        case '"':
+            writer.write("\\\"");
+            break;
+        case '\\':
+            writer.write("\\\\");
+            break;
+        case '\n':
+            writer.write("\\n");
+            break;
+        case '\r':
+            writer.write("\\r");
+            break;
+        case '\t':
+            writer.write("\\t");
+            break;
+        case '\b':
+            writer.write("\\b");
+            break;
+        case '\f':
+            writer.write("\\f");
+            break;
+        default:
+        {
+            char escape[6] = {'\\', 'u', '0', '0', hex[(unsigned char)*special >> 4], hex[*special & 0xF]};
+            writer.write(std::string_view(escape, sizeof(escape)));
+            break;
+        }
         }
+
+        p = special + 1;
+    }
+
+    writer.put('"');
+}
+
+class JsonData
+{
+public:
+    JsonData() {}
+
+    virtual std::string asString()
+    {
+        return "";
     };
 
-    inline JsonType getType() override
+    virtual std::string_view asStringView()
     {
+        return std::string_view();
+    };
+
+    virtual double asNumber()
+    {
+        return 0;
+    };
+
+    virtual int64_t asInt64()
+    {
+        return 0;
+    };
+
+    virtual uint64_t asUint64()
+    {
+        return 0;
+    };
+
+    virtual bool isInteger()
+    {
+        return false;
+    };
+
+    virtual bool asBool()
+    {
+        return false;
+    };
+
+    virtual JsonObject *asObject()
+    {
+        return nullptr;
+    };
+
+    // The elements live in the parser's memory resource, hence the
+    // std::pmr::vector. asVector copies them into a plain std::vector.
+    virtual std::pmr::vector<JsonData *> *asArray()
+    {
+        return nullptr;
+    };
+
+    inline std::vector<JsonData *> asVector()
+    {
+        std::pmr::vector<JsonData *> *elements = asArray();
+        if (elements == nullptr)
+            return {};
+        return std::vector<JsonData *>(elements->begin(), elements->end());
+    }
+
+    virtual JsonData *operator[](const std::string &key)
+    {
+        return nullptr;
+    };
+
+    virtual JsonData *operator[](int index)
+    {
+        return nullptr;
+    };
+
+    virtual JsonData *get(const std::string &key)
+    {
+        return nullptr;
+    };
+
+    virtual JsonData *get(int index)
+    {
+        return nullptr;
+    };
+
+    virtual JsonData *get(const JsonKey *key)
+    {
+        return nullptr;
+    };
+
+    virtual JsonData *set(const std::string &key, JsonData *data)
+    {
+        return nullptr;
+    };
+
+    virtual JsonData *set(int index, JsonData *data)
+    {
+        return nullptr;
+    };
+
+    virtual void push(JsonData *data){};
+
+    // Removes the last element of an array. The caller owns it.
+    virtual JsonData *pop()
+    {
+        return nullptr;
+    };
+
+    // Ownership taking forms of set, push and pop. The container takes
+    // the tree out of value only when the call succeeds; otherwise value
+    // keeps it and frees it as usual.
+    inline JsonData *set(const std::string &key, Json &&value);
+    inline JsonData *set(int index, Json &&value);
+    inline bool push(Json &&value);
+    inline Json take();
+
+    virtual int size()
+    {
+        return 0;
+    };
+
+    virtual JsonType getType()
+    {
+        return JsonType::JSON_NULL;
+    };
+
+    inline std::string emit()
+    {
+        JsonWriter writer;
+        emit(writer);
+        return writer.take();
+    }
+
+    virtual void emit(JsonWriter &)
+    {
+    }
+
+    virtual void operator=(JsonData *data)
+    {
+    }
+
+    virtual void operator=(std::string str)
+    {
+    }
+
+    virtual void operator=(double num)
+    {
+    }
+
+    virtual void operator=(bool b)
+    {
+    }
+
+    virtual ~JsonData(){};
+};
+
+class JsonString : public JsonData
+{
+public:
+    inline JsonString(std::string str) : str(str.data(), str.size()){};
+
+    inline JsonString(StringBuffer &buffer) : str(buffer.resource())
+    {
+        std::string_view raw;
+        bool hasEscapes;
+        size_t start = buffer.position();
+
+        if (!scanString(buffer, raw, hasEscapes))
+        {
+            buffer.fail(JsonError::INVALID_STRING, "Error parsing string", start);
+            return;
+        }
+
+        if (buffer.getOptions().zeroCopy && !hasEscapes)
+        {
+            view = raw;
+            borrowed = true;
+            return;
+        }
+
+        decodeString(buffer, raw, str);
+    };
+
+    inline std::string asString() override
+    {
+        std::string_view value = asStringView();
+        return std::string(value.data(), value.size());
+    };
+
+    inline std::string_view asStringView() override
+    {
+        if (borrowed)
+            return view;
+        return std::string_view(str.data(), str.size());
+    };
+
+    inline JsonType getType() override
+    {
+        return JsonType::JSON_STRING;
+    };
+
+    inline void operator=(std::string str) override
+    {
+        this->str.assign(str.data(), str.size());
+        borrowed = false;
+    }
+
+    using JsonData::emit;
+
+    inline void emit(JsonWriter &writer) override
+    {
+        writeString(writer, asStringView());
+    }
+
+private:
+    std::pmr::string str;
+    std::string_view view;
+    bool borrowed = false;
+};
+
+class JsonNumber : public JsonData
+{
+public:
+    inline JsonNumber(double num) : kind(Kind::DOUBLE)
+    {
+        value.real = num;
+    };
+
+    inline JsonNumber(int num) : JsonNumber((int64_t)num){};
+
+    inline JsonNumber(int64_t num) : kind(Kind::INT64)
+    {
+        value.int64 = num;
+    };
+
+    inline JsonNumber(uint64_t num) : kind(Kind::UINT64)
+    {
+        value.uint64 = num;
+    };
+
+    inline JsonNumber(StringBuffer &buffer) : kind(Kind::INT64)
+    {
+        JsonNumberToken number;
+
+        value.int64 = 0;
+
+        if (!parseNumberToken(buffer, number))
+        {
+            buffer.fail(JsonError::INVALID_NUMBER, "Error parsing number");
+            return;
+        }
+
+        set(number);
+    };
+
+    inline double asNumber() override
+    {
+        switch (kind)
+        {
+        case Kind::INT64:
+            return (double)value.int64;
+        case Kind::UINT64:
+            return (double)value.uint64;
+        default:
+            return value.real;
+        }
+    };
+
+    inline int64_t asInt64() override
+    {
+        switch (kind)
+        {
+        case Kind::INT64:
+            return value.int64;
+        case Kind::UINT64:
+            return (int64_t)value.uint64;
+        default:
+            return (int64_t)value.real;
+        }
+    };
+
+    inline uint64_t asUint64() override
+    {
+        switch (kind)
+        {
+        case Kind::INT64:
+            return (uint64_t)value.int64;
+        case Kind::UINT64:
+            return value.uint64;
+        default:
+            return (uint64_t)value.real;
+        }
+    };
+
+    inline bool isInteger() override
+    {
+        return kind != Kind::DOUBLE;
+    };
+
+    inline JsonType getType() override
+    {
+        return JsonType::JSON_NUMBER;
+    };
+
+    inline void operator=(double num) override
+    {
+        kind = Kind::DOUBLE;
+        value.real = num;
+    }
+
+    // Integers keep their exact value: non-negative values up to
+    // UINT64_MAX and negative values down to INT64_MIN. Everything else,
+    // including -0, is stored as a double.
+    inline void set(const JsonNumberToken &number)
+    {
+        if (!number.isInteger || (number.isNegative && number.integer == 0))
+        {
+            kind = Kind::DOUBLE;
+            value.real = number.toDouble();
+        }
+        else if (!number.isNegative)
+        {
+            kind = number.integer <= (uint64_t)INT64_MAX ? Kind::INT64 : Kind::UINT64;
+            value.uint64 = number.integer;
+        }
+        else if (number.integer <= (uint64_t)INT64_MAX + 1)
+        {
+            kind = Kind::INT64;
+            value.int64 = (int64_t)(0 - number.integer);
+        }
+        else
+        {
+            kind = Kind::DOUBLE;
+            value.real = number.toDouble();
+        }
+    }
+
+    using JsonData::emit;
+
+    inline void emit(JsonWriter &writer) override
+    {
+        switch (kind)
+        {
+        case Kind::INT64:
+            writeNumber(writer, value.int64);
+            break;
+        case Kind::UINT64:
+            writeNumber(writer, value.uint64);
+            break;
+        default:
+            writeNumber(writer, value.real);
+            break;
+        }
+    }
+
+private:
+    enum class Kind : uint8_t
+    {
+        INT64,
+        UINT64,
+        DOUBLE
+    };
+
+    Kind kind;
+    union
+    {
+        int64_t int64;
+        uint64_t uint64;
+        double real;
+    } value;
+};
+
+class JsonBool : public JsonData
+{
+public:
+    inline JsonBool(bool b) : b(b){};
+
+    inline JsonBool(StringBuffer &buffer)
+    {
+        b = parseBool(buffer);
+    };
+
+    inline bool asBool() override
+    {
+        return b;
+    };
+
+    inline JsonType getType() override
+    {
+        return JsonType::JSON_BOOL;
+    };
+
+    inline void operator=(bool b) override
+    {
+        this->b = b;
+    }
+
+    using JsonData::emit;
+
+    inline void emit(JsonWriter &writer) override
+    {
+        writer.write(b ? std::string_view("true") : std::string_view("false"));
+    }
+
+private:
+    bool b;
+};
+
+class JsonNull : public JsonData
+{
+
+public:
+    inline JsonNull(){};
+
+    inline JsonNull(StringBuffer &buffer)
+    {
+        parseNull(buffer);
+    };
+
+    inline JsonType getType() override
+    {
+        return JsonType::JSON_NULL;
+    };
+
+    using JsonData::emit;
+
+    inline void emit(JsonWriter &writer) override
+    {
+        writer.write("null");
+    }
+};
+
+class JsonArray : public JsonData
+{
+public:
+    inline JsonArray() : data(std::pmr::new_delete_resource()){};
+
+    // Empty array in the buffer's memory resource; parseToJsonData
+    // fills it.
+    inline JsonArray(StringBuffer &buffer) : data(buffer.resource()){};
+
+    inline std::pmr::vector<JsonData *> *asArray() override
+    {
+        return &data;
+    };
+
+    inline JsonData *operator[](int index) override
+    {
+        return data[index];
+    };
+
+    inline JsonData *get(int index) override
+    {
+        return data[index];
+    };
+
+    inline JsonType getType() override
+    {
+        return JsonType::JSON_ARRAY;
+    };
+
+    inline int size() override
+    {
+        return data.size();
+    };
+
+    using JsonData::push;
+    using JsonData::set;
+
+    // Replaces the element at index, freeing the old one unless the
+    // array lives in a document arena. Returns nullptr when index is out
+    // of range.
+    inline JsonData *set(int index, JsonData *value) override
+    {
+        if (index < 0 || (size_t)index >= data.size())
+            return nullptr;
+
+        if (data[index] != value && data.get_allocator().resource() == std::pmr::new_delete_resource())
+            delete data[index];
+        data[index] = value;
+        return value;
+    };
+
+    inline void push(JsonData *data) override
+    {
+        this->data.push_back(data);
+    };
+
+    inline JsonData *pop() override
+    {
+        if (data.empty())
+            return nullptr;
+
+        JsonData *data = this->data.back();
+        this->data.pop_back();
+        return data;
+    };
+
+    // Non-virtual push for the parser.
+    inline void append(JsonData *value)
+    {
+        data.push_back(value);
+    }
+
+    inline ~JsonArray() override
+    {
+        for (auto &d : data)
+        {
+            delete d;
+        }
+    };
+
+    using JsonData::emit;
+
+    inline void emit(JsonWriter &writer) override
+    {
+        writer.put('[');
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            if (i != 0)
+                writer.put(',');
+            data[i]->emit(writer);
+        }
+        writer.put(']');
+    }
+
+private:
+    std::pmr::vector<JsonData *> data;
+};
+
+// FNV-1a
+inline uint64_t hashKey(std::string_view key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : key)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// An object key with its hash, followed in memory by its characters.
+// Keys handed out by a JsonKeyPool are shared by every object of the
+// document, and two of them are equal exactly when the pointers are.
+struct JsonKey
+{
+    uint64_t hash;
+    uint32_t length;
+    bool interned;
+
+    inline std::string_view str() const
+    {
+        return std::string_view(reinterpret_cast<const char *>(this + 1), length);
+    }
+
+    inline bool equals(std::string_view key, uint64_t keyHash) const
+    {
+        return hash == keyHash && length == key.size() &&
+               memcmp(this + 1, key.data(), length) == 0;
+    }
+
+    static inline JsonKey *create(std::string_view key, uint64_t hash, bool interned,
+                                  std::pmr::memory_resource *resource)
+    {
+        void *memory = resource->allocate(sizeof(JsonKey) + key.size(), alignof(JsonKey));
+        JsonKey *result = new (memory) JsonKey{hash, (uint32_t)key.size(), interned};
+        memcpy(result + 1, key.data(), key.size());
+        return result;
+    }
+
+    static inline void destroy(const JsonKey *key, std::pmr::memory_resource *resource)
+    {
+        resource->deallocate(const_cast<JsonKey *>(key), sizeof(JsonKey) + key->length, alignof(JsonKey));
+    }
+};
+
+// Interned keys of one document, allocated from the document arena.
+class JsonKeyPool
+{
+public:
+    inline JsonKeyPool(std::pmr::memory_resource *resource)
+        : resource(resource), slots(16, nullptr, resource), count(0){};
+
+    inline const JsonKey *intern(std::string_view key)
+    {
+        uint64_t hash = hashKey(key);
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+
+        for (; slots[i] != nullptr; i = (i + 1) & mask)
+        {
+            if (slots[i]->equals(key, hash))
+                return slots[i];
+        }
+
+        const JsonKey *result = JsonKey::create(key, hash, true, resource);
+        slots[i] = result;
+
+        if (++count * 2 > slots.size())
+            grow();
+
+        return result;
+    }
+
+    inline size_t size()
+    {
+        return count;
+    }
+
+private:
+    inline void grow()
+    {
+        std::pmr::vector<const JsonKey *> old(slots.size() * 2, nullptr, resource);
+        old.swap(slots);
+
+        size_t mask = slots.size() - 1;
+        for (const JsonKey *key : old)
+        {
+            if (key == nullptr)
+                continue;
+            size_t i = key->hash & mask;
+            while (slots[i] != nullptr)
+                i = (i + 1) & mask;
+            slots[i] = key;
+        }
+    }
+
+    std::pmr::memory_resource *resource;
+    std::pmr::vector<const JsonKey *> slots;
+    size_t count;
+};
+
+// Object members kept in insertion order. Small objects are searched
+// linearly; past JSON_OBJECT_LINEAR_MAX keys an open addressing table of
+// member indices is added on top of the member list. Keys that are not
+// interned are owned by the map.
+class JsonObjectMap
+{
+public:
+    struct Entry
+    {
+        const JsonKey *key;
+        JsonData *value;
+    };
+
+    inline JsonObjectMap(std::pmr::memory_resource *resource)
+        : entries(resource), slots(resource){};
+
+    JsonObjectMap(const JsonObjectMap &) = delete;
+    JsonObjectMap &operator=(const JsonObjectMap &) = delete;
+
+    inline ~JsonObjectMap()
+    {
+        for (auto &entry : entries)
+        {
+            if (!entry.key->interned)
+                JsonKey::destroy(entry.key, entries.get_allocator().resource());
+        }
+    }
+
+    inline JsonData **find(std::string_view key)
+    {
+        size_t index = indexOf(key, hashKey(key));
+        if (index == npos)
+            return nullptr;
+        return &entries[index].value;
+    }
+
+    inline JsonData **find(const JsonKey *key)
+    {
+        size_t index = indexOf(key);
+        if (index == npos)
+            return nullptr;
+        return &entries[index].value;
+    }
+
+    // Returns the value slot for key, adding a null member when the key
+    // is new.
+    inline JsonData *&slot(std::string_view key, bool &inserted)
+    {
+        uint64_t hash = hashKey(key);
+        size_t index = indexOf(key, hash);
+
+        inserted = index == npos;
+        if (!inserted)
+            return entries[index].value;
+
+        return add(JsonKey::create(key, hash, false, entries.get_allocator().resource()));
+    }
+
+    inline JsonData *&slot(const JsonKey *key, bool &inserted)
+    {
+        size_t index = indexOf(key);
+
+        inserted = index == npos;
+        if (!inserted)
+            return entries[index].value;
+
+        return add(key);
+    }
+
+    inline size_t size()
+    {
+        return entries.size();
+    }
+
+    inline std::pmr::memory_resource *resource()
+    {
+        return entries.get_allocator().resource();
+    }
+
+    inline std::pmr::vector<Entry>::iterator begin()
+    {
+        return entries.begin();
+    }
+
+    inline std::pmr::vector<Entry>::iterator end()
+    {
+        return entries.end();
+    }
+
+private:
+    static constexpr size_t npos = (size_t)-1;
+
+    inline size_t indexOf(std::string_view key, uint64_t hash)
+    {
+        if (slots.empty())
+        {
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                if (entries[i].key->equals(key, hash))
+                    return i;
+            }
+            return npos;
+        }
+
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; slots[i] != 0; i = (i + 1) & mask)
+        {
+            if (entries[slots[i] - 1].key->equals(key, hash))
+                return slots[i] - 1;
+        }
+        return npos;
+    }
+
+    inline size_t indexOf(const JsonKey *key)
+    {
+        if (slots.empty())
+        {
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                if (entries[i].key == key)
+                    return i;
+            }
+
+            // Interned keys may still sit next to owned copies of the
+            // same text, so fall back to comparing contents.
+            return indexOf(key->str(), key->hash);
+        }
+
+        size_t mask = slots.size() - 1;
+        for (size_t i = key->hash & mask; slots[i] != 0; i = (i + 1) & mask)
+        {
+            const JsonKey *candidate = entries[slots[i] - 1].key;
+            if (candidate == key || candidate->equals(key->str(), key->hash))
+                return slots[i] - 1;
+        }
+        return npos;
+    }
+
+    inline JsonData *&add(const JsonKey *key)
+    {
+        entries.push_back(Entry{key, nullptr});
+
+        if (!slots.empty())
+        {
+            if (entries.size() * 2 > slots.size())
+                rehash(slots.size() * 2);
+            else
+                insertSlot(entries.size() - 1);
+        }
+        else if (entries.size() > JSON_OBJECT_LINEAR_MAX)
+        {
+            rehash(32);
+        }
+
+        return entries.back().value;
+    }
+
+    inline void insertSlot(size_t index)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = entries[index].key->hash & mask;
+        while (slots[i] != 0)
+            i = (i + 1) & mask;
+        slots[i] = (uint32_t)(index + 1);
+    }
+
+    inline void rehash(size_t capacity)
+    {
+        slots.assign(capacity, 0);
+        for (size_t i = 0; i < entries.size(); i++)
+            insertSlot(i);
+    }
+
+    std::pmr::vector<Entry> entries;
+    std::pmr::vector<uint32_t> slots; // member index + 1, 0 when empty
+};
+
+class JsonObject : public JsonData
+{
+
+public:
+    inline JsonObject() : data(std::pmr::new_delete_resource()){};
+
+    // Empty object in the buffer's memory resource; parseToJsonData
+    // fills it.
+    inline JsonObject(StringBuffer &buffer) : data(buffer.resource()){};
+
+    inline JsonData *operator[](const std::string &key) override
+    {
+        return get(key);
+    };
+
+    inline JsonData *get(const std::string &key) override
+    {
+        JsonData **value = data.find(key);
+        return value ? *value : nullptr;
+    };
+
+    // Lookup by a key interned in the document the object was parsed
+    // into; compares pointers before falling back to the key text.
+    inline JsonData *get(const JsonKey *key) override
+    {
+        JsonData **value = data.find(key);
+        return value ? *value : nullptr;
+    };
+
+    using JsonData::set;
+
+    // Adds or replaces the member. A replaced value is freed unless the
+    // object lives in a document arena, which owns it.
+    inline JsonData *set(const std::string &key, JsonData *value) override
+    {
+        bool inserted;
+        JsonData *&slot = data.slot(key, inserted);
+        if (!inserted && slot != value && data.resource() == std::pmr::new_delete_resource())
+            delete slot;
+        slot = value;
+        return value;
+    };
+
+    // Value slot for key, added when the key is new, for the parser.
+    // The key is interned when a pool is given.
+    inline JsonData *&slot(std::string_view key, JsonKeyPool *keys)
+    {
+        bool inserted;
+        return keys ? data.slot(keys->intern(key), inserted) : data.slot(key, inserted);
+    }
+
+    // Members in insertion order, each with key and value.
+    inline std::pmr::vector<JsonObjectMap::Entry>::iterator begin()
+    {
+        return data.begin();
+    }
+
+    inline std::pmr::vector<JsonObjectMap::Entry>::iterator end()
+    {
+        return data.end();
+    }
+
+    inline JsonType getType() override
+    {
+        return JsonType::JSON_OBJECT;
+    };
+
+    inline int size() override
+    {
+        return data.size();
+    };
+
+    inline JsonObject *asObject() override
+    {
+        return this;
+    };
+
+    inline ~JsonObject() override
+    {
+        for (auto &d : data)
+        {
+            delete d.value;
+        }
+    };
+
+    using JsonData::emit;
+
+    inline void emit(JsonWriter &writer) override
+    {
+        writer.put('{');
+        bool first = true;
+        for (auto &d : data)
+        {
+            if (!first)
+                writer.put(',');
+            first = false;
+            writeString(writer, d.key->str());
+            writer.put(':');
+            d.value->emit(writer);
+        }
+        writer.put('}');
+    }
+
+private:
+    JsonObjectMap data;
+};
+
+// Reads an object key and the ':' after it and hands the key to the
+// builder of parseValue.
+template <typename Builder>
+inline bool parseKey(StringBuffer &buffer, Builder &builder)
+{
+    std::string_view key;
+    bool hasEscapes;
+    if (!scanString(buffer, key, hasEscapes))
+    {
+        buffer.fail(JsonError::INVALID_OBJECT, "Error parsing object. Invalid Key.");
+        return false;
+    }
+
+    buffer.skipWhitespace();
+
+    if (buffer.peek() != ':')
+    {
+        buffer.fail(JsonError::INVALID_OBJECT, "Error parsing object. Expected ':' character between key and value.");
+        return false;
+    }
+    buffer.next();
+
+    return builder.key(key, hasEscapes);
+}
+
+// Parses the value at the buffer position with an explicit stack of open
+// containers instead of recursion, so nesting is bounded by
+// JsonParseOptions::maxDepth rather than by the call stack. The builder
+// parses scalars itself and is told about containers and keys:
+//   bool scalar(StringBuffer &buffer)
+//   bool startObject(), bool endObject(), bool startArray(), bool endArray()
+//   bool key(std::string_view raw, bool hasEscapes)
+// Each returns false to stop. Returns false when the parse failed or was
+// stopped.
+template <typename Builder>
+inline bool parseValue(StringBuffer &buffer, Builder &builder)
+{
+    std::vector<char> stack; // closing bracket of each open container
+    size_t maxDepth = buffer.getOptions().maxDepth;
+    size_t startDepth = buffer.startDepth();
+
+    while (true)
+    {
+        buffer.skipWhitespace();
+        char next = buffer.peek();
+
+        if (next == '{' || next == '[')
+        {
+            bool isObject = next == '{';
+            char close = isObject ? '}' : ']';
+
+            if (startDepth + stack.size() >= maxDepth)
+            {
+                buffer.fail(JsonError::DEPTH_EXCEEDED, "Maximum nesting depth of " + std::to_string(maxDepth) + " exceeded");
+                return false;
+            }
+            buffer.next();
+
+            if (!(isObject ? builder.startObject() : builder.startArray()))
+                return false;
+            stack.push_back(close);
+
+            buffer.skipWhitespace();
+
+            if (buffer.peek() != close)
+            {
+                if (isObject && !parseKey(buffer, builder))
+                    return false;
+                continue;
+            }
+
+            buffer.next();
+            stack.pop_back();
+
+            if (!(isObject ? builder.endObject() : builder.endArray()))
+                return false;
+        }
+        else if (!builder.scalar(buffer))
+        {
+            return false;
+        }
+
+        // Close the containers that end here, then go on with the next
+        // member of the innermost one still open.
+        while (true)
+        {
+            if (stack.empty())
+                return true;
+
+            char close = stack.back();
+            buffer.skipWhitespace();
+            char c = buffer.peek();
+
+            if (c == ',')
+            {
+                buffer.next();
+                buffer.skipWhitespace();
+
+                if (buffer.peek() != close)
+                {
+                    if (close == '}' && !parseKey(buffer, builder))
+                        return false;
+                    break;
+                }
+                c = close;
+            }
+
+            if (c != close)
+            {
+                if (close == '}')
+                    buffer.fail(JsonError::INVALID_OBJECT, "Error parsing object. Expected ending '}'");
+                else
+                    buffer.fail(JsonError::INVALID_ARRAY, "Error parsing array. Expected ',' or ']'");
+                return false;
+            }
+
+            buffer.next();
+            stack.pop_back();
+
+            if (!(close == '}' ? builder.endObject() : builder.endArray()))
+                return false;
+        }
+    }
+}
+
+#define JSON_DATA_CASE(value, type) \
+    case value:                     \
+        return addScalar(buffer.create<type>());
+
+// Builds JsonData nodes for parseValue, in the buffer's arena when it has
+// one.
+class JsonTreeBuilder
+{
+public:
+    inline JsonTreeBuilder(StringBuffer &buffer) : buffer(buffer){};
+
+    inline bool scalar(StringBuffer &buffer)
+    {
+        char next = buffer.peek();
+
+        switch (next)
+        {
+            JSON_DATA_CASE('"', JsonString);
+            JSON_DATA_CASE('t', JsonBool);
+            JSON_DATA_CASE('f', JsonBool);
+            JSON_DATA_CASE('n', JsonNull);
+            JSON_DATA_CASE('-', JsonNumber);
+            JSON_DATA_CASE('0', JsonNumber);
+            JSON_DATA_CASE('1', JsonNumber);
+            JSON_DATA_CASE('2', JsonNumber);
+            JSON_DATA_CASE('3', JsonNumber);
+            JSON_DATA_CASE('4', JsonNumber);
+            JSON_DATA_CASE('5', JsonNumber);
+            JSON_DATA_CASE('6', JsonNumber);
+            JSON_DATA_CASE('7', JsonNumber);
+            JSON_DATA_CASE('8', JsonNumber);
+            JSON_DATA_CASE('9', JsonNumber);
+
+        default:
+            buffer.fail(JsonError::INVALID_CHARACTER, next == '\0' ? std::string("Unexpected end of input")
+                                                                    : "Invalid character found: " + std::string(1, next));
+            return false;
+        }
+    }
+
+    inline bool startObject()
+    {
+        JsonObject *object = buffer.create<JsonObject>();
+        add(object);
+        frames.push_back(Frame{object, nullptr, nullptr, std::string_view(), false});
+        return true;
+    }
+
+    inline bool startArray()
+    {
+        JsonArray *array = buffer.create<JsonArray>();
+        add(array);
+        frames.push_back(Frame{nullptr, array, nullptr, std::string_view(), false});
+        return true;
+    }
+
+    inline bool endObject()
+    {
+        return end();
+    }
+
+    inline bool endArray()
+    {
+        return end();
+    }
+
+    inline bool key(std::string_view raw, bool hasEscapes)
+    {
+        std::string_view key = raw;
+        if (hasEscapes)
+        {
+            if (!decodeString(buffer, raw, decoded))
+                return false;
+            key = decoded;
+        }
+
+        Frame &frame = frames.back();
+        frame.slot = &frame.object->slot(key, buffer.keyPool());
+        frame.key = raw;
+        frame.pending = true;
+        return true;
+    }
+
+    inline JsonData *getRoot()
+    {
+        return root;
+    }
+
+    // Names the keys whose values the parse failed in, outermost first,
+    // in the error message.
+    inline void describeFailure()
+    {
+        std::string &message = buffer.getResult().message;
+        for (size_t i = frames.size(); i-- > 0;)
+        {
+            if (frames[i].object && frames[i].pending)
+                message = "Error parsing object. Value error for key=[" + std::string(frames[i].key) + "]. | " + message;
+        }
+    }
+
+private:
+    struct Frame
+    {
+        JsonObject *object;
+        JsonArray *array;
+        JsonData **slot;       // value slot of the current member
+        std::string_view key;  // its key as written
+        bool pending;          // between the key and the end of its value
+    };
+
+    // Containers are attached when they open, so the root owns
+    // everything built so far.
+    inline void add(JsonData *value)
+    {
+        if (frames.empty())
+        {
+            root = value;
+            return;
+        }
+
+        // A duplicate key replaces the earlier value, which is freed
+        // unless it lives in a document arena.
+        Frame &frame = frames.back();
+        if (frame.object)
+        {
+            if (*frame.slot && buffer.resource() == std::pmr::new_delete_resource())
+                delete *frame.slot;
+            *frame.slot = value;
+        }
+        else
+        {
+            frame.array->append(value);
+        }
+    }
+
+    inline bool addScalar(JsonData *value)
+    {
+        add(value);
+        if (buffer.failed())
+            return false;
+        if (!frames.empty())
+            frames.back().pending = false;
+        return true;
+    }
+
+    inline bool end()
+    {
+        frames.pop_back();
+        if (!frames.empty())
+            frames.back().pending = false;
+        return true;
+    }
+
+    StringBuffer &buffer;
+    std::vector<Frame> frames;
+    JsonData *root = nullptr;
+    std::string decoded;
+};
+
+inline JsonData *parseToJsonData(StringBuffer &buffer)
+{
+    JsonTreeBuilder builder(buffer);
+
+    if (!parseValue(buffer, builder))
+        builder.describeFailure();
+
+    return builder.getRoot();
+}
+
+// Parses a top level value into a heap allocated tree. The outcome is
+// published for hasError() and getError(); on failure the partial tree
+// is freed and nullptr returned.
+inline JsonData *parseJSON(StringBuffer &buffer)
+{
+    JsonData *data = parseToJsonData(buffer);
+
+    lastParseResult = buffer.getResult();
+
+    if (buffer.failed())
+    {
+        delete data;
+        return nullptr;
+    }
+
+    return data;
+}
+
+inline JsonData *JSON(std::string_view str, const JsonParseOptions &options, ParseResult &result)
+{
+    StringBuffer buffer(str, options);
+    JsonData *data = parseJSON(buffer);
+    result = buffer.getResult();
+    return data;
+}
+
+inline JsonData *JSON(std::string_view str, ParseResult &result)
+{
+    return JSON(str, JsonParseOptions(), result);
+}
+
+inline JsonData *JSON(std::string_view str, const JsonParseOptions &options)
+{
+    StringBuffer buffer(str, options);
+    return parseJSON(buffer);
+}
+
+inline JsonData *JSON(std::string_view str)
+{
+    StringBuffer buffer(str);
+    return parseJSON(buffer);
+}
+
+inline JsonData *JSON(const std::string &str)
+{
+    StringBuffer buffer(str);
+    return parseJSON(buffer);
+}
+
+inline JsonData *JSON(const char *str)
+{
+    StringBuffer buffer(str);
+    return parseJSON(buffer);
+}
+
+inline JsonData *JSON(const char *str, int len)
+{
+    StringBuffer buffer(std::string_view(str, len));
+    return parseJSON(buffer);
+}
+
+// Reads the rest of a stream in large blocks.
+inline std::string readStream(std::istream &stream)
+{
+    std::string str;
+    char block[65536];
+
+    while (stream.read(block, sizeof(block)) || stream.gcount() > 0)
+        str.append(block, stream.gcount());
+
+    return str;
+}
+
+inline JsonData *JSON(std::ifstream &file)
+{
+    std::string str = readStream(file);
+    StringBuffer buffer(str);
+    return parseJSON(buffer);
+}
+
+inline JsonData *JSON(std::istream &stream)
+{
+    std::string str = readStream(stream);
+    StringBuffer buffer(str);
+    return parseJSON(buffer);
+}
+
+// Event handler for JSON_sax. Every callback returns whether to keep
+// going; returning false stops the parse early without an error. Derive
+// from this and hide the callbacks you need, the rest are no-ops. The
+// handler is a template parameter, so the calls are resolved statically
+// and can be inlined.
+struct JsonSaxHandler
+{
+    inline bool onStartObject() { return true; }
+    inline bool onEndObject() { return true; }
+    inline bool onStartArray() { return true; }
+    inline bool onEndArray() { return true; }
+    // Views are only valid for the duration of the call.
+    inline bool onKey(std::string_view) { return true; }
+    inline bool onString(std::string_view) { return true; }
+    inline bool onNumber(const JsonNumberToken &) { return true; }
+    inline bool onBool(bool) { return true; }
+    inline bool onNull() { return true; }
+};
+
+// Adapts a JsonSaxHandler to the builder interface of parseValue.
+template <typename Handler>
+class JsonSaxBuilder
+{
+public:
+    inline JsonSaxBuilder(StringBuffer &buffer, Handler &handler) : buffer(buffer), handler(handler){};
+
+    inline bool scalar(StringBuffer &buffer)
+    {
+        size_t start = buffer.position();
+        char next = buffer.peek();
+
+        switch (next)
+        {
+        case '"':
+        {
+            std::string_view raw;
+            bool hasEscapes;
+            if (!scanString(buffer, raw, hasEscapes))
+            {
+                buffer.fail(JsonError::INVALID_STRING, "Error parsing string", start);
+                return false;
+            }
+            if (hasEscapes)
+            {
+                if (!decodeString(buffer, raw, scratch))
+                    return false;
+                raw = scratch;
+            }
+            return handler.onString(raw);
+        }
+        case 't':
+        case 'f':
+        {
+            bool value = parseBool(buffer);
+            return !buffer.failed() && handler.onBool(value);
+        }
+        case 'n':
+            return parseNull(buffer) && handler.onNull();
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+        {
+            JsonNumberToken number;
+            if (!parseNumberToken(buffer, number))
+            {
+                buffer.fail(JsonError::INVALID_NUMBER, "Error parsing number");
+                return false;
+            }
+            return handler.onNumber(number);
+        }
+        default:
+            buffer.fail(JsonError::INVALID_CHARACTER, next == '\0' ? std::string("Unexpected end of input")
+                                                                    : "Invalid character found: " + std::string(1, next));
+            return false;
+        }
+    }
+
+    inline bool startObject()
+    {
+        return handler.onStartObject();
+    }
+
+    inline bool endObject()
+    {
+        return handler.onEndObject();
+    }
+
+    inline bool startArray()
+    {
+        return handler.onStartArray();
+    }
+
+    inline bool endArray()
+    {
+        return handler.onEndArray();
+    }
+
+    inline bool key(std::string_view raw, bool hasEscapes)
+    {
+        if (hasEscapes)
+        {
+            if (!decodeString(buffer, raw, scratch))
+                return false;
+            raw = scratch;
+        }
+        return handler.onKey(raw);
+    }
+
+private:
+    StringBuffer &buffer;
+    Handler &handler;
+    std::string scratch;
+};
+
+// Parses str and reports it to handler as a stream of events without
+// building a tree, using memory proportional to the nesting depth.
+// Returns false only on a parse error; a handler that stops early is
+// not an error.
+template <typename Handler>
+inline bool JSON_sax(std::string_view str, Handler &handler, const JsonParseOptions &options, ParseResult &result)
+{
+    StringBuffer buffer(str, options);
+    JsonSaxBuilder<Handler> builder(buffer, handler);
+
+    parseValue(buffer, builder);
+
+    result = buffer.getResult();
+    lastParseResult = result;
+    return result.ok();
+}
+
+template <typename Handler>
+inline bool JSON_sax(std::string_view str, Handler &handler, ParseResult &result)
+{
+    return JSON_sax(str, handler, JsonParseOptions(), result);
+}
+
+template <typename Handler>
+inline bool JSON_sax(std::string_view str, Handler &handler)
+{
+    ParseResult result;
+    return JSON_sax(str, handler, JsonParseOptions(), result);
+}
+
+// Returns the end of the string starting at p, after its closing quote,
+// or nullptr if it is not terminated.
+inline const char *skipString(const char *p, const char *end)
+{
+    char quote = *p++;
+
+    while ((p = findQuoteOrBackslash(p, end, quote)) < end && *p != quote)
+        p += 2;
+
+    return p < end ? p + 1 : nullptr;
+}
+
+// Returns the end of the value starting at p, or nullptr if it is not
+// terminated. Containers are matched by counting brackets outside of
+// strings; their contents are not validated.
+inline const char *skipValue(const char *p, const char *end)
+{
+    if (p >= end)
+        return nullptr;
+
+    if (*p == '"' || *p == '\'')
+        return skipString(p, end);
+
+    if (*p != '{' && *p != '[')
+    {
+        while (p < end && !isDelimiter(*p) && *p != ':')
+            p++;
+        return p;
+    }
+
+    size_t depth = 0;
+
+    while (p < end)
+    {
+        switch (*p)
+        {
+        case '"':
+        case '\'':
+            p = skipString(p, end);
+            if (p == nullptr)
+                return nullptr;
+            continue;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0)
+                return p + 1;
+            break;
+        }
+        p++;
+    }
+
+    return nullptr;
+}
+
+// Handle on a value in unparsed text. Lookups walk the members of an
+// object or array and skip the ones they pass over without parsing
+// them, so reading a few fields of a large document only parses those
+// fields. A handle that does not refer to a value (a missing key, an
+// index out of range, or malformed text) is not valid and reads as
+// null. The text must outlive the handle. Strings are not checked for
+// valid UTF-8.
+class LazyJson
+{
+public:
+    inline LazyJson(){};
+
+    inline LazyJson(std::string_view text) : LazyJson(text.data(), text.data() + text.size()){};
+
+    inline bool isValid()
+    {
+        return begin != nullptr;
+    }
+
+    inline explicit operator bool()
+    {
+        return isValid();
+    }
+
+    inline JsonType getType()
+    {
+        if (!isValid())
+            return JsonType::JSON_NULL;
+
+        switch (*begin)
+        {
+        case '{':
+            return JsonType::JSON_OBJECT;
+        case '[':
+            return JsonType::JSON_ARRAY;
+        case '"':
+            return JsonType::JSON_STRING;
+        case 't':
+        case 'f':
+            return JsonType::JSON_BOOL;
+        case 'n':
+            return JsonType::JSON_NULL;
+        default:
+            return JsonType::JSON_NUMBER;
+        }
+    }
+
+    // Member of an object. The whole object is walked, so a repeated key
+    // finds its last value, as in JSON().
+    inline LazyJson get(std::string_view key)
+    {
+        if (getType() != JsonType::JSON_OBJECT)
+            return LazyJson();
+
+        LazyJson found;
+        std::string decoded;
+        const char *p = skipWhitespace(begin + 1);
+
+        while (p < end && *p != '}')
+        {
+            if (*p != '"' && *p != '\'')
+                return LazyJson();
+
+            const char *keyEnd = skipString(p, end);
+            if (keyEnd == nullptr)
+                return LazyJson();
+
+            std::string_view name(p + 1, keyEnd - p - 2);
+            if (name.find('\\') != std::string_view::npos)
+            {
+                if (!decodeString(name, decoded))
+                    return LazyJson();
+                name = decoded;
+            }
+
+            p = skipWhitespace(keyEnd);
+            if (p >= end || *p != ':')
+                return LazyJson();
+
+            p = skipWhitespace(p + 1);
+            if (name == key)
+                found = LazyJson(p, end);
+
+            if ((p = nextMember(p, '}')) == nullptr)
+                return LazyJson();
+        }
+
+        return found;
+    }
+
+    // Element of an array.
+    inline LazyJson get(size_t index)
+    {
+        if (getType() != JsonType::JSON_ARRAY)
+            return LazyJson();
+
+        const char *p = skipWhitespace(begin + 1);
+
+        for (size_t i = 0; p < end && *p != ']'; i++)
+        {
+            if (i == index)
+                return LazyJson(p, end);
+
+            if ((p = nextMember(p, ']')) == nullptr)
+                return LazyJson();
+        }
+
+        return LazyJson();
+    }
+
+    inline LazyJson operator[](std::string_view key)
+    {
+        return get(key);
+    }
+
+    inline LazyJson operator[](int index)
+    {
+        return get((size_t)index);
+    }
+
+    // Number of members of an object or elements of an array.
+    inline int size()
+    {
+        JsonType type = getType();
+        if (type != JsonType::JSON_OBJECT && type != JsonType::JSON_ARRAY)
+            return 0;
+
+        char close = type == JsonType::JSON_OBJECT ? '}' : ']';
+        const char *p = skipWhitespace(begin + 1);
+        int count = 0;
+
+        while (p < end && *p != close)
+        {
+            if (type == JsonType::JSON_OBJECT)
+            {
+                p = skipString(p, end);
+                p = p ? skipWhitespace(p) : nullptr;
+                if (p == nullptr || p >= end || *p != ':')
+                    return count;
+                p = skipWhitespace(p + 1);
+            }
+
+            count++;
+
+            if ((p = nextMember(p, close)) == nullptr)
+                return count;
+        }
+
+        return count;
+    }
+
+    inline std::string asString()
+    {
+        if (getType() != JsonType::JSON_STRING)
+            return "";
+
+        StringBuffer buffer(raw());
+        std::string value = parseString(buffer);
+        return buffer.failed() ? "" : value;
+    }
+
+    inline double asNumber()
+    {
+        JsonNumberToken number;
+        return parseNumberToken(number) ? number.toDouble() : 0;
+    }
+
+    inline int64_t asInt64()
+    {
+        JsonNumberToken number;
+        if (!parseNumberToken(number))
+            return 0;
+        if (!number.isInteger)
+            return (int64_t)number.real;
+        return number.isNegative ? (int64_t)(0 - number.integer) : (int64_t)number.integer;
+    }
+
+    inline bool asBool()
+    {
+        return getType() == JsonType::JSON_BOOL && raw() == "true";
+    }
+
+    inline bool isNull()
+    {
+        return !isValid() || raw() == "null";
+    }
+
+    // Text of the value, as written.
+    inline std::string_view raw()
+    {
+        if (!isValid())
+            return std::string_view();
+
+        const char *valueEnd = skipValue(begin, end);
+        return valueEnd ? std::string_view(begin, valueEnd - begin) : std::string_view();
+    }
+
+    // Fully parses the value into a heap allocated tree owned by the
+    // caller, or returns nullptr on a parse error.
+    inline JsonData *materialize()
+    {
+        std::string_view text = raw();
+        if (text.empty())
+            return nullptr;
+
+        StringBuffer buffer(text);
+        return parseJSON(buffer);
+    }
+
+private:
+    inline LazyJson(const char *begin, const char *end) : end(end)
+    {
+        const char *p = skipWhitespace(begin);
+        if (p < end)
+            this->begin = p;
+    };
+
+    inline const char *skipWhitespace(const char *p)
+    {
+        while (p < end && isWhitespace(*p))
+            p++;
+        return p;
+    }
+
+    // Skips the member value at p and the separator after it. Returns the
+    // start of the next member, the closing bracket, or nullptr.
+    inline const char *nextMember(const char *p, char close)
+    {
+        p = skipValue(p, end);
+        if (p == nullptr)
+            return nullptr;
+
+        p = skipWhitespace(p);
+        if (p < end && *p == ',')
+            return skipWhitespace(p + 1);
+        if (p < end && *p == close)
+            return p;
+        return nullptr;
+    }
+
+    inline bool parseNumberToken(JsonNumberToken &number)
+    {
+        if (getType() != JsonType::JSON_NUMBER)
+            return false;
+
+        StringBuffer buffer(raw());
+        return ::parseNumberToken(buffer, number);
+    }
+
+    const char *begin = nullptr;
+    const char *end = nullptr;
+};
+
+// A JSON Pointer (RFC 6901) such as "/items/0/name", parsed once and
+// evaluated any number of times. Each reference token keeps its key with
+// the hash already computed and its array index already converted, so
+// evaluation does no string parsing or hashing.
+class JsonPointer
+{
+public:
+    inline JsonPointer(std::string_view pointer)
+    {
+        if (pointer.empty())
+            return;
+
+        if (pointer[0] != '/')
+        {
+            valid = false;
+            return;
+        }
+
+        std::string name;
+        size_t start = 1;
+
+        while (true)
+        {
+            size_t end = pointer.find('/', start);
+            if (end == std::string_view::npos)
+                end = pointer.size();
+
+            name.clear();
+            for (size_t i = start; i < end; i++)
+            {
+                if (pointer[i] != '~')
+                {
+                    name += pointer[i];
+                    continue;
+                }
+
+                if (i + 1 >= end || (pointer[i + 1] != '0' && pointer[i + 1] != '1'))
+                {
+                    valid = false;
+                    tokens.clear();
+                    return;
+                }
+                name += pointer[++i] == '0' ? '~' : '/';
+            }
+            tokens.emplace_back(name);
+
+            if (end == pointer.size())
+                break;
+            start = end + 1;
+        }
+    };
+
+    // False when the pointer is malformed; it then matches nothing.
+    inline bool isValid() const
+    {
+        return valid;
+    }
+
+    // Number of reference tokens; the empty pointer refers to the root.
+    inline size_t size() const
+    {
+        return tokens.size();
+    }
+
+    // The value at the pointer, or nullptr when there is none.
+    inline JsonData *evaluate(JsonData *root) const
+    {
+        if (!valid)
+            return nullptr;
+
+        for (const Token &token : tokens)
+        {
+            if (root == nullptr)
+                return nullptr;
+
+            switch (root->getType())
+            {
+            case JsonType::JSON_OBJECT:
+                root = root->get(token.key());
+                break;
+            case JsonType::JSON_ARRAY:
+                root = token.isIndex && token.index < (size_t)root->size() ? root->get((int)token.index) : nullptr;
+                break;
+            default:
+                return nullptr;
+            }
+        }
+
+        return root;
+    }
+
+    // The value at the pointer in a compact document, or nullptr.
+    inline const JsonValue *evaluate(const JsonValue *root) const;
+
+    // The value at the pointer within unparsed text. Members that are not
+    // on the path are skipped without being parsed.
+    inline LazyJson evaluate(LazyJson root) const
+    {
+        if (!valid)
+            return LazyJson();
+
+        for (const Token &token : tokens)
+        {
+            switch (root.getType())
+            {
+            case JsonType::JSON_OBJECT:
+                root = root.get(token.key()->str());
+                break;
+            case JsonType::JSON_ARRAY:
+                root = token.isIndex ? root.get(token.index) : LazyJson();
+                break;
+            default:
+                return LazyJson();
+            }
+
+            if (!root)
+                return root;
+        }
+
+        return root;
+    }
+
+private:
+    struct Token
+    {
+        inline Token(const std::string &name)
+        {
+            storage.resize((sizeof(JsonKey) + name.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            JsonKey *header = new (storage.data()) JsonKey{hashKey(name), (uint32_t)name.size(), false};
+            memcpy(header + 1, name.data(), name.size());
+
+            // "0" or digits without a leading zero; "-" never matches.
+            const char *end = name.data() + name.size();
+            isIndex = !name.empty() && (name.size() == 1 || name[0] != '0') &&
+                      std::all_of(name.begin(), name.end(), isDigit) &&
+                      std::from_chars(name.data(), end, index).ec == std::errc();
+        }
+
+        inline const JsonKey *key() const
+        {
+            return reinterpret_cast<const JsonKey *>(storage.data());
+        }
+
+        std::vector<uint64_t> storage; // JsonKey followed by the characters
+        size_t index = 0;
+        bool isIndex = false;
+    };
+
+    std::vector<Token> tokens;
+    bool valid = true;
+};
+
+// Reports only the value at pointer to handler. The rest of the text is
+// skipped without being parsed. Returns false when nothing is at pointer
+// or the value fails to parse; errors are located in the whole text.
+template <typename Handler>
+inline bool JSON_sax(std::string_view str, const JsonPointer &pointer, Handler &handler,
+                     const JsonParseOptions &options, ParseResult &result)
+{
+    result = ParseResult();
+
+    std::string_view target = pointer.evaluate(LazyJson(str)).raw();
+    if (target.empty())
+        return false;
+
+    if (JSON_sax(target, handler, options, result))
+        return true;
+
+    size_t offset = target.data() - str.data() + result.offset;
+    result.line = 1;
+    result.column = offset + 1;
+    for (size_t i = 0; i < offset; i++)
+    {
+        if (str[i] == '\n')
+        {
+            result.line++;
+            result.column = offset - i;
+        }
+    }
+    result.offset = offset;
+    lastParseResult = result;
+    return false;
+}
+
+template <typename Handler>
+inline bool JSON_sax(std::string_view str, const JsonPointer &pointer, Handler &handler)
+{
+    ParseResult result;
+    return JSON_sax(str, pointer, handler, JsonParseOptions(), result);
+}
+
+// Compact read only alternative to the JsonData tree. A value is 16
+// bytes with no vtable: an 8 byte payload, a 32 bit length and a tag.
+// Strings of up to 14 bytes are stored inline. The children of an array
+// or object are stored next to each other in one block (objects as
+// alternating key and value), so traversals walk contiguous memory.
+// Values are owned by a JsonCompactDocument.
+class JsonValue
+{
+public:
+    static constexpr size_t inlineCapacity = 14;
+
+    inline JsonValue() : tag(Tag::NULL_VALUE)
+    {
+        memset(bytes, 0, sizeof(bytes));
+    };
+
+    inline JsonType getType() const
+    {
+        switch (tag)
+        {
+        case Tag::BOOL:
+            return JsonType::JSON_BOOL;
+        case Tag::INT64:
+        case Tag::UINT64:
+        case Tag::DOUBLE:
+            return JsonType::JSON_NUMBER;
+        case Tag::STRING:
+        case Tag::INLINE_STRING:
+            return JsonType::JSON_STRING;
+        case Tag::ARRAY:
+            return JsonType::JSON_ARRAY;
+        case Tag::OBJECT:
+            return JsonType::JSON_OBJECT;
+        default:
+            return JsonType::JSON_NULL;
+        }
+    }
+
+    inline std::string_view asStringView() const
+    {
+        if (tag == Tag::INLINE_STRING)
+            return std::string_view(bytes, (unsigned char)bytes[inlineCapacity]);
+        if (tag == Tag::STRING)
+            return std::string_view(load<const char *>(0), load<uint32_t>(8));
+        return std::string_view();
+    }
+
+    inline std::string asString() const
+    {
+        std::string_view value = asStringView();
+        return std::string(value.data(), value.size());
+    }
+
+    inline double asNumber() const
+    {
+        switch (tag)
+        {
+        case Tag::INT64:
+            return (double)load<int64_t>(0);
+        case Tag::UINT64:
+            return (double)load<uint64_t>(0);
+        case Tag::DOUBLE:
+            return load<double>(0);
+        default:
+            return 0;
+        }
+    }
+
+    inline int64_t asInt64() const
+    {
+        switch (tag)
+        {
+        case Tag::INT64:
+        case Tag::UINT64:
+            return load<int64_t>(0);
+        case Tag::DOUBLE:
+            return (int64_t)load<double>(0);
+        default:
+            return 0;
+        }
+    }
+
+    inline uint64_t asUint64() const
+    {
+        switch (tag)
+        {
+        case Tag::INT64:
+        case Tag::UINT64:
+            return load<uint64_t>(0);
+        case Tag::DOUBLE:
+            return (uint64_t)load<double>(0);
+        default:
+            return 0;
+        }
+    }
+
+    inline bool isInteger() const
+    {
+        return tag == Tag::INT64 || tag == Tag::UINT64;
+    }
+
+    inline bool asBool() const
+    {
+        return tag == Tag::BOOL && bytes[0] != 0;
+    }
+
+    // Number of elements of an array or members of an object.
+    inline int size() const
+    {
+        return tag == Tag::ARRAY || tag == Tag::OBJECT ? (int)load<uint32_t>(8) : 0;
+    }
+
+    // Member of an object, or nullptr. Members are kept as written and
+    // searched from the end, so a repeated key finds its last value, as
+    // in JSON().
+    inline const JsonValue *get(std::string_view key) const
+    {
+        if (tag != Tag::OBJECT)
+            return nullptr;
+
+        const JsonValue *members = children();
+        for (size_t i = load<uint32_t>(8); i-- > 0;)
+        {
+            if (members[2 * i].asStringView() == key)
+                return &members[2 * i + 1];
+        }
+        return nullptr;
+    }
+
+    // Element of an array, or the value of the index-th member of an
+    // object; nullptr when out of range.
+    inline const JsonValue *get(size_t index) const
+    {
+        if (index >= (size_t)size())
+            return nullptr;
+        return tag == Tag::ARRAY ? &children()[index] : &children()[2 * index + 1];
+    }
+
+    inline const JsonValue *operator[](std::string_view key) const
+    {
+        return get(key);
+    }
+
+    inline const JsonValue *operator[](int index) const
+    {
+        return get((size_t)index);
+    }
+
+    // Key of the index-th member of an object.
+    inline std::string_view key(size_t index) const
+    {
+        if (tag != Tag::OBJECT || index >= (size_t)size())
+            return std::string_view();
+        return children()[2 * index].asStringView();
+    }
+
+    inline std::string emit() const
+    {
+        JsonWriter writer;
+        emit(writer);
+        return writer.take();
+    }
+
+    inline void emit(JsonWriter &writer) const
+    {
+        switch (tag)
+        {
+        case Tag::NULL_VALUE:
+            writer.write("null");
+            break;
+        case Tag::BOOL:
+            writer.write(asBool() ? std::string_view("true") : std::string_view("false"));
+            break;
+        case Tag::INT64:
+            writeNumber(writer, load<int64_t>(0));
+            break;
+        case Tag::UINT64:
+            writeNumber(writer, load<uint64_t>(0));
+            break;
+        case Tag::DOUBLE:
+            writeNumber(writer, load<double>(0));
+            break;
+        case Tag::STRING:
+        case Tag::INLINE_STRING:
+            writeString(writer, asStringView());
+            break;
+        case Tag::ARRAY:
+            writer.put('[');
+            for (int i = 0; i < size(); i++)
+            {
+                if (i != 0)
+                    writer.put(',');
+                children()[i].emit(writer);
+            }
+            writer.put(']');
+            break;
+        case Tag::OBJECT:
+            writer.put('{');
+            for (int i = 0; i < size(); i++)
+            {
+                if (i != 0)
+                    writer.put(',');
+                children()[2 * i].emit(writer);
+                writer.put(':');
+                children()[2 * i + 1].emit(writer);
+            }
+            writer.put('}');
+            break;
+        }
+    }
+
+    static inline JsonValue boolean(bool value)
+    {
+        JsonValue result(Tag::BOOL);
+        result.bytes[0] = value;
+        return result;
+    }
+
+    // Same rules as JsonNumber::set: integers keep their exact value.
+    static inline JsonValue number(const JsonNumberToken &number)
+    {
+        if (!number.isInteger || (number.isNegative && number.integer == 0) ||
+            (number.isNegative && number.integer > (uint64_t)INT64_MAX + 1))
+        {
+            JsonValue result(Tag::DOUBLE);
+            result.store(0, number.toDouble());
+            return result;
+        }
+
+        if (number.isNegative)
+        {
+            JsonValue result(Tag::INT64);
+            result.store(0, (int64_t)(0 - number.integer));
+            return result;
+        }
+
+        JsonValue result(number.integer <= (uint64_t)INT64_MAX ? Tag::INT64 : Tag::UINT64);
+        result.store(0, number.integer);
+        return result;
+    }
+
+    // Short strings are copied inline, longer ones into resource.
+    static inline JsonValue string(std::string_view value, std::pmr::memory_resource *resource)
+    {
+        if (value.size() <= inlineCapacity)
+        {
+            JsonValue result(Tag::INLINE_STRING);
+            memcpy(result.bytes, value.data(), value.size());
+            result.bytes[inlineCapacity] = (char)value.size();
+            return result;
+        }
+
+        char *copy = (char *)resource->allocate(value.size(), 1);
+        memcpy(copy, value.data(), value.size());
+
+        JsonValue result(Tag::STRING);
+        result.store(0, (const char *)copy);
+        result.store(8, (uint32_t)value.size());
+        return result;
+    }
+
+    // Copies values into resource as the children of an array, or of an
+    // object when they alternate key and value.
+    static inline JsonValue container(JsonType type, const JsonValue *values, size_t count,
+                                      std::pmr::memory_resource *resource)
+    {
+        JsonValue *block = nullptr;
+        if (count > 0)
+        {
+            block = (JsonValue *)resource->allocate(count * sizeof(JsonValue), alignof(JsonValue));
+            memcpy((void *)block, values, count * sizeof(JsonValue));
+        }
+
+        bool isObject = type == JsonType::JSON_OBJECT;
+        JsonValue result(isObject ? Tag::OBJECT : Tag::ARRAY);
+        result.store(0, (const JsonValue *)block);
+        result.store(8, (uint32_t)(isObject ? count / 2 : count));
+        return result;
+    }
+
+private:
+    enum class Tag : uint8_t
+    {
+        NULL_VALUE,
+        BOOL,
+        INT64,
+        UINT64,
+        DOUBLE,
+        STRING,
+        INLINE_STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    inline JsonValue(Tag tag) : JsonValue()
+    {
+        this->tag = tag;
+    };
+
+    inline const JsonValue *children() const
+    {
+        return load<const JsonValue *>(0);
+    }
+
+    // The payload sits in bytes 0-7 and the length in bytes 8-11; an
+    // inline string uses bytes 0-13 and keeps its length in byte 14.
+    template <typename T>
+    inline T load(size_t offset) const
+    {
+        T value;
+        memcpy(&value, bytes + offset, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    inline void store(size_t offset, T value)
+    {
+        memcpy(bytes + offset, &value, sizeof(T));
+    }
+
+    alignas(8) char bytes[15];
+    Tag tag;
+};
+
+static_assert(sizeof(JsonValue) == 16, "JsonValue must stay 16 bytes");
+
+inline const JsonValue *JsonPointer::evaluate(const JsonValue *root) const
+{
+    if (!valid)
+        return nullptr;
+
+    for (const Token &token : tokens)
+    {
+        if (root == nullptr)
+            return nullptr;
+
+        switch (root->getType())
+        {
+        case JsonType::JSON_OBJECT:
+            root = root->get(token.key()->str());
+            break;
+        case JsonType::JSON_ARRAY:
+            root = token.isIndex ? root->get(token.index) : nullptr;
+            break;
+        default:
+            return nullptr;
+        }
+    }
+
+    return root;
+}
+
+// SAX handler that builds JsonValues. Children of the open containers
+// wait on one stack and are copied to the arena in a single block when
+// their container ends.
+class JsonValueBuilder : public JsonSaxHandler
+{
+public:
+    inline JsonValueBuilder(std::pmr::memory_resource *resource) : resource(resource){};
+
+    inline bool onStartObject()
+    {
+        starts.push_back(values.size());
+        return true;
+    }
+
+    inline bool onEndObject()
+    {
+        return end(JsonType::JSON_OBJECT);
+    }
+
+    inline bool onStartArray()
+    {
+        starts.push_back(values.size());
+        return true;
+    }
+
+    inline bool onEndArray()
+    {
+        return end(JsonType::JSON_ARRAY);
+    }
+
+    inline bool onKey(std::string_view key)
+    {
+        values.push_back(JsonValue::string(key, resource));
+        return true;
+    }
+
+    inline bool onString(std::string_view value)
+    {
+        values.push_back(JsonValue::string(value, resource));
+        return true;
+    }
+
+    inline bool onNumber(const JsonNumberToken &number)
+    {
+        values.push_back(JsonValue::number(number));
+        return true;
+    }
+
+    inline bool onBool(bool value)
+    {
+        values.push_back(JsonValue::boolean(value));
+        return true;
+    }
+
+    inline bool onNull()
+    {
+        values.push_back(JsonValue());
+        return true;
+    }
+
+    // The top level value once the parse has finished.
+    inline JsonValue getRoot()
+    {
+        return values.empty() ? JsonValue() : values.front();
+    }
+
+private:
+    inline bool end(JsonType type)
+    {
+        size_t start = starts.back();
+        starts.pop_back();
+
+        JsonValue container = JsonValue::container(type, values.data() + start, values.size() - start, resource);
+        values.resize(start);
+        values.push_back(container);
+        return true;
+    }
+
+    std::pmr::memory_resource *resource;
+    std::vector<JsonValue> values;
+    std::vector<size_t> starts;
+};
+
+// Owns a tree of JsonValues and the arena they are stored in.
+class JsonCompactDocument
+{
+public:
+    inline JsonCompactDocument(){};
+
+    JsonCompactDocument(const JsonCompactDocument &) = delete;
+    JsonCompactDocument &operator=(const JsonCompactDocument &) = delete;
+    JsonCompactDocument(JsonCompactDocument &&) = default;
+    JsonCompactDocument &operator=(JsonCompactDocument &&) = default;
+
+    inline const JsonValue *parse(std::string_view str, const JsonParseOptions &options = JsonParseOptions())
+    {
+        size_t initialSize = str.size() < 4096 ? 4096 : str.size();
+        arena.reset(new std::pmr::monotonic_buffer_resource(initialSize));
+
+        JsonValueBuilder builder(arena.get());
+        JSON_sax(str, builder, options, result);
+        root = builder.getRoot();
+        return getRoot();
+    }
+
+    inline bool hasError()
+    {
+        return !result.ok();
+    }
+
+    inline const ParseResult &getResult()
+    {
+        return result;
+    }
+
+    // nullptr before a parse or after a failed one.
+    inline const JsonValue *getRoot()
+    {
+        return arena && result.ok() ? &root : nullptr;
+    }
+
+private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+    JsonValue root;
+    ParseResult result;
+};
+
+inline JsonCompactDocument JSON_compact(std::string_view str, const JsonParseOptions &options = JsonParseOptions())
+{
+    JsonCompactDocument doc;
+    doc.parse(str, options);
+    return doc;
+}
+
+// The contents of a file, memory mapped when it is a regular file and
+// read into memory otherwise (pipes, character devices, or platforms
+// without mmap).
+class JsonMappedFile
+{
+public:
+    inline JsonMappedFile(const std::string &filename)
+    {
+#ifdef JSON_HAS_POSIX
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char *>(mapping);
+                length = info.st_size;
+                mapped = true;
+                opened = true;
+                ::close(fd);
+                return;
+            }
+        }
+
+        char block[65536];
+        ssize_t count;
+        while ((count = ::read(fd, block, sizeof(block))) > 0)
+            contents.append(block, count);
+        opened = count == 0;
+        ::close(fd);
+#else
+        std::ifstream file(filename, std::ios::binary);
+        opened = file.is_open();
+        contents = readStream(file);
+#endif
+        data = contents.data();
+        length = contents.size();
+    }
+
+    JsonMappedFile(const JsonMappedFile &) = delete;
+    JsonMappedFile &operator=(const JsonMappedFile &) = delete;
+
+    inline ~JsonMappedFile()
+    {
+#ifdef JSON_HAS_POSIX
+        if (mapped)
+            munmap(const_cast<char *>(data), length);
+#endif
+    }
+
+    inline bool ok()
+    {
+        return opened;
+    }
+
+    inline bool isMapped()
+    {
+        return mapped;
+    }
+
+    inline std::string_view view()
+    {
+        return std::string_view(data, length);
+    }
+
+private:
+    const char *data = "";
+    size_t length = 0;
+    bool mapped = false;
+    bool opened = false;
+    std::string contents;
+};
+
+// Owns a parsed tree whose nodes, strings, child containers and interned
+// object keys all live in one monotonic arena. A parse costs a handful of
+// large allocations and destroying the document frees them without
+// visiting the nodes, so the tree must not be deleted by hand. Nodes
+// created with toJsonData() and attached to the tree are not freed by the
+// document.
+class JsonDocument
+{
+public:
+    inline JsonDocument() : root(nullptr){};
+
+    JsonDocument(const JsonDocument &) = delete;
+    JsonDocument &operator=(const JsonDocument &) = delete;
+
+    // The moved-from document is left empty, as if never parsed.
+    inline JsonDocument(JsonDocument &&other) noexcept
+        : arena(std::move(other.arena)), keys(other.keys), root(other.root),
+          result(std::move(other.result)), source(std::move(other.source))
+    {
+        other.keys = nullptr;
+        other.root = nullptr;
+    }
+
+    inline JsonDocument &operator=(JsonDocument &&other) noexcept
+    {
+        if (this != &other)
+        {
+            arena = std::move(other.arena);
+            keys = other.keys;
+            root = other.root;
+            result = std::move(other.result);
+            source = std::move(other.source);
+            other.keys = nullptr;
+            other.root = nullptr;
+        }
+        return *this;
+    }
+
+    inline JsonData *parse(std::string_view str, const JsonParseOptions &options = JsonParseOptions())
+    {
+        size_t initialSize = str.size() < 4096 ? 4096 : str.size();
+        arena.reset(new std::pmr::monotonic_buffer_resource(initialSize));
+        keys = new (arena->allocate(sizeof(JsonKeyPool), alignof(JsonKeyPool))) JsonKeyPool(arena.get());
+        StringBuffer buffer(str, options, arena.get(), keys);
+        root = parseToJsonData(buffer);
+        result = buffer.getResult();
+        lastParseResult = result;
+        if (!result.ok())
+            root = nullptr;
+        return root;
+    }
+
+    // Maps filename and parses it in place. The document keeps the
+    // mapping alive, so with zeroCopy strings point into the file.
+    inline JsonData *load(const std::string &filename, const JsonParseOptions &options)
+    {
+        std::unique_ptr<JsonMappedFile> file(new JsonMappedFile(filename));
+
+        if (!file->ok())
+        {
+            root = nullptr;
+            result = ParseResult();
+            result.error = JsonError::FILE_ERROR;
+            result.message = "Error opening file " + filename;
+            lastParseResult = result;
+            return nullptr;
+        }
+
+        parse(file->view(), options);
+        source = std::move(file);
+        return root;
+    }
+
+    inline bool hasError()
+    {
+        return !result.ok();
+    }
+
+    inline const ParseResult &getResult()
+    {
+        return result;
+    }
+
+    // Returns the document's shared copy of key, for pointer compared
+    // lookups with JsonData::get(const JsonKey *). nullptr until a
+    // document has been parsed.
+    inline const JsonKey *intern(std::string_view key)
+    {
+        return keys ? keys->intern(key) : nullptr;
+    }
+
+    inline size_t keyCount()
+    {
+        return keys ? keys->size() : 0;
+    }
+
+    inline JsonData *getRoot()
+    {
+        return root;
+    }
+
+private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+    JsonKeyPool *keys = nullptr;
+    JsonData *root;
+    ParseResult result;
+    std::unique_ptr<JsonMappedFile> source;
+};
+
+inline JsonData *JSON_loadf(std::string filename)
+{
+    JsonMappedFile file(filename);
+
+    if (!file.ok())
+    {
+        lastParseResult = ParseResult();
+        lastParseResult.error = JsonError::FILE_ERROR;
+        lastParseResult.message = "Error opening file " + filename;
+        return nullptr;
+    }
+
+    StringBuffer buffer(file.view());
+    return parseJSON(buffer);
+}
+
+// Loads a file into a document that parses the mapped file in place,
+// with zero-copy strings unless options say otherwise.
+inline JsonDocument JSON_loadf_mmap(const std::string &filename, const JsonParseOptions &options)
+{
+    JsonDocument doc;
+    doc.load(filename, options);
+    return doc;
+}
+
+inline JsonDocument JSON_loadf_mmap(const std::string &filename)
+{
+    JsonParseOptions options;
+    options.zeroCopy = true;
+    return JSON_loadf_mmap(filename, options);
+}
+
+// Reports an existing tree to handler as the events JSON_sax would
+// produce for its text. Returns false when the handler stopped.
+template <typename Handler>
+inline bool JSON_sax(JsonData *data, Handler &handler)
+{
+    switch (data->getType())
+    {
+    case JsonType::JSON_OBJECT:
+        if (!handler.onStartObject())
+            return false;
+        for (auto &member : *data->asObject())
+        {
+            if (!handler.onKey(member.key->str()) || !JSON_sax(member.value, handler))
+                return false;
+        }
+        return handler.onEndObject();
+    case JsonType::JSON_ARRAY:
+        if (!handler.onStartArray())
+            return false;
+        for (JsonData *element : *data->asArray())
+        {
+            if (!JSON_sax(element, handler))
+                return false;
+        }
+        return handler.onEndArray();
+    case JsonType::JSON_STRING:
+        return handler.onString(data->asStringView());
+    case JsonType::JSON_NUMBER:
+    {
+        JsonNumberToken number;
+        number.isInteger = data->isInteger();
+        if (!number.isInteger)
+            number.real = data->asNumber();
+        else if (data->asNumber() < 0) // asInt64 wraps above INT64_MAX
+        {
+            number.isNegative = true;
+            number.integer = 0 - (uint64_t)data->asInt64();
+        }
+        else
+            number.integer = data->asUint64();
+        return handler.onNumber(number);
+    }
+    case JsonType::JSON_BOOL:
+        return handler.onBool(data->asBool());
+    default:
+        return handler.onNull();
+    }
+}
+
+// Header of the binary format written by JSON_dumpb: the tape entries
+// follow it, then the string arena. Everything is stored as offsets, so
+// a file can be mapped at any address and used in place.
+struct JsonBinaryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // 0x01020304 as written by the producing machine
+    uint64_t entryCount;
+    uint64_t stringSize;
+};
+
+static_assert(sizeof(JsonBinaryHeader) % sizeof(uint64_t) == 0, "tape entries must stay aligned");
+
+class JsonTape;
+
+// Handle on one value of a JsonTape. Cheap to copy; valid as long as the
+// tape is. A handle that does not refer to a value reads as null.
+class JsonTapeRef
+{
+public:
+    class Iterator;
+
+    inline JsonTapeRef() : tape(nullptr), index(0){};
+
+    inline JsonTapeRef(const JsonTape *tape, size_t index) : tape(tape), index(index){};
+
+    inline bool isValid() const
+    {
+        return tape != nullptr;
+    }
+
+    inline explicit operator bool() const
+    {
+        return isValid();
+    }
+
+    inline JsonType getType() const;
+    inline std::string_view asStringView() const;
+    inline std::string asString() const;
+    inline double asNumber() const;
+    inline int64_t asInt64() const;
+    inline uint64_t asUint64() const;
+    inline bool isInteger() const;
+    inline bool asBool() const;
+
+    // Number of elements of an array or members of an object.
+    inline int size() const;
+
+    // Member of an object; skips over the values of the other members
+    // without visiting their contents. The tape keeps every member as
+    // written, so a repeated key finds its last value, as in JSON().
+    inline JsonTapeRef get(std::string_view key) const;
+
+    // Element of an array.
+    inline JsonTapeRef get(size_t index) const;
+
+    inline JsonTapeRef operator[](std::string_view key) const
+    {
+        return get(key);
+    }
+
+    inline JsonTapeRef operator[](int index) const
+    {
+        return get((size_t)index);
+    }
+
+    // Iterates the elements of an array or the members of an object.
+    inline Iterator begin() const;
+    inline Iterator end() const;
+
+    inline std::string emit() const
+    {
+        JsonWriter writer;
+        emit(writer);
+        return writer.take();
+    }
+
+    inline void emit(JsonWriter &writer) const;
+
+    // Tape index one past this value.
+    inline size_t next() const;
+
+private:
+    inline char type() const;
+    inline uint64_t payload() const;
+    inline uint64_t word(size_t offset) const;
+
+    const JsonTape *tape;
+    size_t index;
+};
+
+// Read only document stored as one flat array of 64 bit entries plus one
+// string arena, so a whole document is two allocations and skipping a
+// container is a single jump. Each entry keeps a type character in its
+// top 8 bits and a payload in the low 56:
+//   '{' '['      index one past the matching close entry in the low 32
+//                bits, member or element count (saturating) above that
+//   '}' ']'      index of the matching open entry
+//   '"'          arena offset of a 32 bit length, the characters and '\0'
+//   'l' 'u' 'd'  int64, uint64 or double, stored in the next entry
+//   't' 'f' 'n'  true, false, null
+// Object members are a key string entry followed by the value.
+class JsonTape
+{
+public:
+    static constexpr uint32_t countMax = 0xFFFFFF;
+
+    inline JsonTape(){};
+
+    JsonTape(const JsonTape &) = delete;
+    JsonTape &operator=(const JsonTape &) = delete;
+    JsonTape(JsonTape &&) = default;
+    JsonTape &operator=(JsonTape &&) = default;
+
+    inline bool parse(std::string_view str, const JsonParseOptions &options = JsonParseOptions())
+    {
+        // Both buffers are sized from the text so that they usually never
+        // grow: an entry takes at least one byte of input and decoded
+        // strings are never longer than their source.
+        tapeData.clear();
+        tapeData.reserve(str.size() + 2);
+        stringData.clear();
+        stringData.reserve(str.size() + 16);
+
+        Builder builder(*this);
+        JSON_sax(str, builder, options, result);
+
+        if (!result.ok())
+        {
+            tapeData.clear();
+            stringData.clear();
+        }
+        source.reset();
+        entryData = tapeData.data();
+        entryCount = tapeData.size();
+        stringBase = stringData.data();
+        return result.ok();
+    }
+
+    // Builds the tape from an existing tree.
+    inline void assign(JsonData *data)
+    {
+        tapeData.clear();
+        stringData.clear();
+        source.reset();
+        result = ParseResult();
+
+        Builder builder(*this);
+        JSON_sax(data, builder);
+
+        entryData = tapeData.data();
+        entryCount = tapeData.size();
+        stringBase = stringData.data();
+    }
+
+    // Writes the tape in the binary format read by load.
+    inline bool save(const std::string &filename) const
+    {
+        JsonBinaryHeader header = binaryHeader();
+        header.entryCount = entryCount;
+        header.stringSize = stringSize();
+
+        std::ofstream file(filename, std::ios::binary);
+        file.write((const char *)&header, sizeof(header));
+        file.write((const char *)entryData, entryCount * sizeof(uint64_t));
+        file.write(stringBase, header.stringSize);
+        file.close();
+        return file.good();
+    }
+
+    // Maps a file written by save or JSON_dumpb and uses it in place,
+    // without parsing. Only the header is checked; the contents are
+    // trusted.
+    inline bool load(const std::string &filename)
+    {
+        tapeData.clear();
+        stringData.clear();
+        entryData = nullptr;
+        entryCount = 0;
+        stringBase = nullptr;
+        result = ParseResult();
+
+        std::unique_ptr<JsonMappedFile> file(new JsonMappedFile(filename));
+        if (!file->ok())
+            return fail("Error opening file " + filename);
+
+        std::string_view data = file->view();
+        JsonBinaryHeader expected = binaryHeader();
+        JsonBinaryHeader header;
+
+        if (data.size() < sizeof(header))
+            return fail("Invalid binary json file " + filename);
+        memcpy(&header, data.data(), sizeof(header));
+
+        if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+            header.byteOrder != expected.byteOrder || header.entryCount > (data.size() - sizeof(header)) / sizeof(uint64_t) ||
+            data.size() - sizeof(header) - header.entryCount * sizeof(uint64_t) != header.stringSize)
+            return fail("Invalid binary json file " + filename);
+
+        const char *entries = data.data() + sizeof(header);
+        entryCount = header.entryCount;
+        stringBase = entries + entryCount * sizeof(uint64_t);
+
+        if ((uintptr_t)entries % alignof(uint64_t) == 0)
+        {
+            entryData = (const uint64_t *)entries;
+        }
+        else
+        {
+            // A read in buffer need not be aligned; copy the entries.
+            tapeData.resize(entryCount);
+            memcpy(tapeData.data(), entries, entryCount * sizeof(uint64_t));
+            entryData = tapeData.data();
+        }
+
+        source = std::move(file);
+        return true;
+    }
+
+    inline bool hasError() const
+    {
+        return !result.ok();
+    }
+
+    inline const ParseResult &getResult() const
+    {
+        return result;
+    }
+
+    // Invalid before a parse or after a failed one.
+    inline JsonTapeRef getRoot() const
+    {
+        return entryCount > 0 ? JsonTapeRef(this, 0) : JsonTapeRef();
+    }
+
+    inline const uint64_t *entries() const
+    {
+        return entryData;
+    }
+
+    inline size_t size() const
+    {
+        return entryCount;
+    }
+
+    inline const char *strings() const
+    {
+        return stringBase;
+    }
+
+    static inline uint64_t entry(char type, uint64_t payload)
+    {
+        return ((uint64_t)(unsigned char)type << 56) | (payload & 0xFFFFFFFFFFFFFFULL);
+    }
+
+private:
+    static inline JsonBinaryHeader binaryHeader()
+    {
+        return JsonBinaryHeader{{'J', 'S', 'O', 'N', 'T', 'A', 'P', 'E'}, 1, 0x01020304, 0, 0};
+    }
+
+    inline size_t stringSize() const
+    {
+        if (!source)
+            return stringData.size();
+        return source->view().size() - sizeof(JsonBinaryHeader) - entryCount * sizeof(uint64_t);
+    }
+
+    inline bool fail(std::string message)
+    {
+        result.error = JsonError::FILE_ERROR;
+        result.message = std::move(message);
+        lastParseResult = result;
+        return false;
+    }
+
+    // Appends SAX events to the tape. Open containers get their entry
+    // patched with the jump and count when they close.
+    class Builder : public JsonSaxHandler
+    {
+    public:
+        inline Builder(JsonTape &tape) : tape(tape.tapeData), strings(tape.stringData){};
+
+        inline bool onStartObject()
+        {
+            return open(true);
+        }
+
+        inline bool onEndObject()
+        {
+            return close('{', '}');
+        }
+
+        inline bool onStartArray()
+        {
+            return open(false);
+        }
+
+        inline bool onEndArray()
+        {
+            return close('[', ']');
+        }
+
+        inline bool onKey(std::string_view key)
+        {
+            frames.back().count++;
+            string(key);
+            return true;
+        }
+
+        inline bool onString(std::string_view value)
+        {
+            element();
+            string(value);
+            return true;
+        }
+
+        inline bool onNumber(const JsonNumberToken &number)
+        {
+            element();
+
+            JsonValue value = JsonValue::number(number);
+            uint64_t bits;
+            char type;
+
+            if (!value.isInteger())
+            {
+                double real = value.asNumber();
+                memcpy(&bits, &real, sizeof(bits));
+                type = 'd';
+            }
+            else if (value.asUint64() > (uint64_t)INT64_MAX && !number.isNegative)
+            {
+                bits = value.asUint64();
+                type = 'u';
+            }
+            else
+            {
+                bits = (uint64_t)value.asInt64();
+                type = 'l';
+            }
+
+            tape.push_back(entry(type, 0));
+            tape.push_back(bits);
+            return true;
+        }
+
+        inline bool onBool(bool value)
+        {
+            element();
+            tape.push_back(entry(value ? 't' : 'f', 0));
+            return true;
+        }
+
+        inline bool onNull()
+        {
+            element();
+            tape.push_back(entry('n', 0));
+            return true;
+        }
+
+    private:
+        struct Frame
+        {
+            size_t start;
+            uint32_t count;
+            bool isObject;
+        };
+
+        // Counts a value towards its enclosing array.
+        inline void element()
+        {
+            if (!frames.empty() && !frames.back().isObject)
+                frames.back().count++;
+        }
+
+        inline bool open(bool isObject)
+        {
+            element();
+            frames.push_back(Frame{tape.size(), 0, isObject});
+            tape.push_back(0);
+            return true;
+        }
+
+        inline bool close(char openType, char closeType)
+        {
+            Frame frame = frames.back();
+            frames.pop_back();
+
+            uint64_t count = frame.count < countMax ? frame.count : countMax;
+            tape.push_back(entry(closeType, frame.start));
+            tape[frame.start] = entry(openType, (count << 32) | tape.size());
+            return true;
+        }
+
+        inline void string(std::string_view value)
+        {
+            uint32_t length = (uint32_t)value.size();
+            tape.push_back(entry('"', strings.size()));
+            strings.insert(strings.end(), (const char *)&length, (const char *)&length + sizeof(length));
+            strings.insert(strings.end(), value.begin(), value.end());
+            strings.push_back('\0');
+        }
+
+        std::vector<uint64_t> &tape;
+        std::vector<char> &strings;
+        std::vector<Frame> frames;
+    };
+
+    std::vector<uint64_t> tapeData;
+    std::vector<char> stringData;
+    const uint64_t *entryData = nullptr;
+    size_t entryCount = 0;
+    const char *stringBase = nullptr;
+    std::unique_ptr<JsonMappedFile> source;
+    ParseResult result;
+};
+
+inline JsonTape JSON_tape(std::string_view str, const JsonParseOptions &options = JsonParseOptions())
+{
+    JsonTape tape;
+    tape.parse(str, options);
+    return tape;
+}
+
+class JsonTapeRef::Iterator
+{
+public:
+    inline Iterator(const JsonTape *tape, size_t index, bool isObject)
+        : tape(tape), index(index), isObject(isObject){};
+
+    // Key of the current member when iterating an object.
+    inline std::string_view key() const
+    {
+        return isObject ? JsonTapeRef(tape, index).asStringView() : std::string_view();
+    }
+
+    inline JsonTapeRef operator*() const
+    {
+        return JsonTapeRef(tape, isObject ? index + 1 : index);
+    }
+
+    inline Iterator &operator++()
+    {
+        index = (**this).next();
+        return *this;
+    }
+
+    inline bool operator!=(const Iterator &other) const
+    {
+        return index != other.index;
+    }
+
+    inline bool operator==(const Iterator &other) const
+    {
+        return index == other.index;
+    }
+
+private:
+    const JsonTape *tape;
+    size_t index;
+    bool isObject;
+};
+
+inline char JsonTapeRef::type() const
+{
+    return tape ? (char)(tape->entries()[index] >> 56) : 'n';
+}
+
+inline uint64_t JsonTapeRef::payload() const
+{
+    return tape->entries()[index] & 0xFFFFFFFFFFFFFFULL;
+}
+
+inline uint64_t JsonTapeRef::word(size_t offset) const
+{
+    return tape->entries()[index + offset];
+}
+
+inline size_t JsonTapeRef::next() const
+{
+    switch (type())
+    {
+    case '{':
+    case '[':
+        return payload() & 0xFFFFFFFF;
+    case 'l':
+    case 'u':
+    case 'd':
+        return index + 2;
+    default:
+        return index + 1;
+    }
+}
+
+inline JsonType JsonTapeRef::getType() const
+{
+    switch (type())
+    {
+    case '{':
+        return JsonType::JSON_OBJECT;
+    case '[':
+        return JsonType::JSON_ARRAY;
+    case '"':
+        return JsonType::JSON_STRING;
+    case 'l':
+    case 'u':
+    case 'd':
+        return JsonType::JSON_NUMBER;
+    case 't':
+    case 'f':
+        return JsonType::JSON_BOOL;
+    default:
         return JsonType::JSON_NULL;
+    }
+}
+
+inline std::string_view JsonTapeRef::asStringView() const
+{
+    if (type() != '"')
+        return std::string_view();
+
+    const char *string = tape->strings() + payload();
+    uint32_t length;
+    memcpy(&length, string, sizeof(length));
+    return std::string_view(string + sizeof(length), length);
+}
+
+inline std::string JsonTapeRef::asString() const
+{
+    std::string_view value = asStringView();
+    return std::string(value.data(), value.size());
+}
+
+inline double JsonTapeRef::asNumber() const
+{
+    uint64_t bits;
+    double real;
+
+    switch (type())
+    {
+    case 'l':
+        return (double)(int64_t)word(1);
+    case 'u':
+        return (double)word(1);
+    case 'd':
+        bits = word(1);
+        memcpy(&real, &bits, sizeof(real));
+        return real;
+    default:
+        return 0;
+    }
+}
+
+inline int64_t JsonTapeRef::asInt64() const
+{
+    char t = type();
+    if (t == 'l' || t == 'u')
+        return (int64_t)word(1);
+    return t == 'd' ? (int64_t)asNumber() : 0;
+}
+
+inline uint64_t JsonTapeRef::asUint64() const
+{
+    char t = type();
+    if (t == 'l' || t == 'u')
+        return word(1);
+    return t == 'd' ? (uint64_t)asNumber() : 0;
+}
+
+inline bool JsonTapeRef::isInteger() const
+{
+    return type() == 'l' || type() == 'u';
+}
+
+inline bool JsonTapeRef::asBool() const
+{
+    return type() == 't';
+}
+
+inline int JsonTapeRef::size() const
+{
+    char t = type();
+    if (t != '{' && t != '[')
+        return 0;
+
+    uint32_t count = (uint32_t)(payload() >> 32);
+    if (count < JsonTape::countMax)
+        return (int)count;
+
+    count = 0;
+    for (Iterator it = begin(); it != end(); ++it)
+        count++;
+    return (int)count;
+}
+
+inline JsonTapeRef JsonTapeRef::get(std::string_view key) const
+{
+    if (type() != '{')
+        return JsonTapeRef();
+
+    JsonTapeRef found;
+    for (Iterator it = begin(); it != end(); ++it)
+    {
+        if (it.key() == key)
+            found = *it;
+    }
+    return found;
+}
+
+inline JsonTapeRef JsonTapeRef::get(size_t index) const
+{
+    if (type() != '[')
+        return JsonTapeRef();
+
+    for (Iterator it = begin(); it != end(); ++it)
+    {
+        if (index-- == 0)
+            return *it;
+    }
+    return JsonTapeRef();
+}
+
+inline JsonTapeRef::Iterator JsonTapeRef::begin() const
+{
+    char t = type();
+    if (t != '{' && t != '[')
+        return end();
+    return Iterator(tape, index + 1, t == '{');
+}
+
+inline JsonTapeRef::Iterator JsonTapeRef::end() const
+{
+    char t = type();
+    if (t != '{' && t != '[')
+        return Iterator(tape, index, false);
+    return Iterator(tape, next() - 1, t == '{');
+}
+
+inline void JsonTapeRef::emit(JsonWriter &writer) const
+{
+    switch (type())
+    {
+    case '{':
+    case '[':
+    {
+        bool isObject = type() == '{';
+        writer.put(isObject ? '{' : '[');
+        for (Iterator it = begin(); it != end(); ++it)
+        {
+            if (it != begin())
+                writer.put(',');
+            if (isObject)
+            {
+                writeString(writer, it.key());
+                writer.put(':');
+            }
+            (*it).emit(writer);
+        }
+        writer.put(isObject ? '}' : ']');
+        break;
+    }
+    case '"':
+        writeString(writer, asStringView());
+        break;
+    case 'l':
+        writeNumber(writer, asInt64());
+        break;
+    case 'u':
+        writeNumber(writer, asUint64());
+        break;
+    case 'd':
+        writeNumber(writer, asNumber());
+        break;
+    case 't':
+        writer.write("true");
+        break;
+    case 'f':
+        writer.write("false");
+        break;
+    default:
+        writer.write("null");
+        break;
+    }
+}
+
+// Saves a tree in the binary tape format, which JSON_loadb maps back
+// without parsing.
+inline bool JSON_dumpb(JsonData *data, const std::string &filename)
+{
+    JsonTape tape;
+    tape.assign(data);
+    return tape.save(filename);
+}
+
+inline bool JSON_dumpb(const JsonTape &tape, const std::string &filename)
+{
+    return tape.save(filename);
+}
+
+inline JsonTape JSON_loadb(const std::string &filename)
+{
+    JsonTape tape;
+    tape.load(filename);
+    return tape;
+}
+
+inline void JSON_dumpf(JsonData *data, std::string filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+    JsonWriter writer(file);
+    data->emit(writer);
+    writer.flush();
+    file.close();
+}
+
+inline std::string JSON_emit(JsonData *data)
+{
+    return data->emit();
+}
+
+inline void JSON_emit(JsonData *data, JsonWriter &writer)
+{
+    data->emit(writer);
+}
+
+inline void JSON_emit(JsonData *data, std::ostream &stream)
+{
+    JsonWriter writer(stream);
+    data->emit(writer);
+}
+
+// A fixed set of worker threads that run the iterations of a loop in
+// parallel. The calling thread works on the loop too.
+class JsonThreadPool
+{
+public:
+    inline JsonThreadPool(size_t threads = std::thread::hardware_concurrency())
+    {
+        for (size_t i = 1; i < threads; i++)
+            workers.emplace_back([this]()
+                                 { workerLoop(); });
+    }
+
+    JsonThreadPool(const JsonThreadPool &) = delete;
+    JsonThreadPool &operator=(const JsonThreadPool &) = delete;
+
+    inline ~JsonThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    // Number of threads working on a loop, counting the caller.
+    inline size_t size()
+    {
+        return workers.size() + 1;
+    }
+
+    // Calls task(i) for every i in [0, count) and returns once all calls
+    // have finished. Concurrent callers take turns.
+    inline void run(size_t count, const std::function<void(size_t)> &task)
+    {
+        std::lock_guard<std::mutex> turn(runMutex);
+
+        if (workers.empty() || count < 2)
+        {
+            for (size_t i = 0; i < count; i++)
+                task(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &task;
+            jobCount = count;
+            next = 0;
+            active = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        work();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]()
+                  { return active == 0; });
+        job = nullptr;
+    }
+
+private:
+    inline void work()
+    {
+        size_t i;
+        while ((i = next.fetch_add(1)) < jobCount)
+            (*job)(i);
+    }
+
+    inline void workerLoop()
+    {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;)
+        {
+            wake.wait(lock, [&]()
+                      { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+
+            lock.unlock();
+            work();
+            lock.lock();
+
+            if (--active == 0)
+                done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)> *job = nullptr;
+    size_t jobCount = 0;
+    std::atomic<size_t> next{0};
+    size_t active = 0;
+    size_t generation = 0;
+    bool stopping = false;
+};
+
+inline JsonThreadPool &defaultThreadPool()
+{
+    static JsonThreadPool pool;
+    return pool;
+}
+
+// Parses a top level array on several threads. The structural index is
+// walked once to find the commas that separate the top level elements,
+// the elements are split into byte balanced chunks, each chunk is parsed
+// on the pool with its own StringBuffer sharing the index, and the
+// resulting children are appended to the root in order. Anything that is
+// not a large top level array is parsed on the calling thread.
+inline JsonData *JSON_parallel(std::string_view str, JsonThreadPool &pool, const JsonParseOptions &options, ParseResult &result)
+{
+    StringBuffer buffer(str, options);
+    buffer.buildIndex();
+
+    const uint32_t *index = buffer.structuralIndex();
+    size_t count = buffer.structuralIndexSize();
+
+    if (str.size() < JSON_PARALLEL_MIN_SIZE || pool.size() < 2 || count == 0 || str[index[0]] != '[' || options.maxDepth == 0)
+    {
+        JsonData *data = parseJSON(buffer);
+        result = buffer.getResult();
+        return data;
+    }
+
+    // Separators of the top level elements: the commas at depth one and
+    // the closing bracket.
+    std::vector<uint32_t> separators;
+    size_t depth = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        char c = str[index[i]];
+        if (c == '[' || c == '{')
+        {
+            depth++;
+        }
+        else if (c == ']' || c == '}')
+        {
+            if (--depth == 0)
+            {
+                separators.push_back(index[i]);
+                break;
+            }
+        }
+        else if (c == ',' && depth == 1)
+        {
+            separators.push_back(index[i]);
+        }
+    }
+
+    if (depth != 0 || str[separators.back()] != ']' || separators.size() < 2)
+    {
+        JsonData *data = parseJSON(buffer);
+        result = buffer.getResult();
+        return data;
+    }
+
+    // The sequential parser accepts a trailing comma before ']'.
+    size_t elements = separators.size();
+    size_t lastStart = separators[elements - 2] + 1;
+    if (std::all_of(str.begin() + lastStart, str.begin() + separators.back(), isWhitespace))
+        elements--;
+
+    size_t chunks = std::min(elements, pool.size() * 4);
+    std::vector<size_t> chunkStart(chunks + 1, elements);
+    for (size_t i = 0, chunk = 0; i < elements && chunk < chunks; i++)
+    {
+        size_t start = i == 0 ? index[0] + 1 : separators[i - 1] + 1;
+        if (start - index[0] >= chunk * (separators.back() - index[0]) / chunks)
+            chunkStart[chunk++] = i;
+    }
+
+    std::vector<std::vector<JsonData *>> children(chunks);
+    std::vector<ParseResult> results(chunks);
+
+    pool.run(chunks, [&](size_t chunk)
+             {
+        size_t first = chunkStart[chunk];
+        size_t last = chunkStart[chunk + 1];
+        // The elements sit inside the top level array.
+        StringBuffer worker(buffer, first == 0 ? index[0] + 1 : separators[first - 1] + 1, 1);
+
+        for (size_t i = first; i < last; i++)
+        {
+            children[chunk].push_back(parseToJsonData(worker));
+            if (worker.failed())
+                break;
+
+            worker.skipWhitespace();
+            if (worker.position() != separators[i])
+            {
+                worker.fail(JsonError::INVALID_ARRAY, "Error parsing array. Expected ',' or ']'");
+                break;
+            }
+            worker.next();
+        }
+
+        results[chunk] = worker.getResult(); });
+
+    JsonArray *root = new JsonArray();
+    root->asArray()->reserve(elements);
+    result = ParseResult();
+
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        if (!results[chunk].ok() && result.ok())
+            result = results[chunk];
+        root->asArray()->insert(root->asArray()->end(), children[chunk].begin(), children[chunk].end());
+    }
+
+    lastParseResult = result;
+
+    if (!result.ok())
+    {
+        delete root;
+        return nullptr;
+    }
+
+    return root;
+}
+
+inline JsonData *JSON_parallel(std::string_view str, ParseResult &result)
+{
+    return JSON_parallel(str, defaultThreadPool(), JsonParseOptions(), result);
+}
+
+inline JsonData *JSON_parallel(std::string_view str)
+{
+    ParseResult result;
+    return JSON_parallel(str, defaultThreadPool(), JsonParseOptions(), result);
+}
+
+// Reads newline delimited JSON (JSON Lines) from a stream one block at a
+// time, so the stream never has to fit in memory. Every complete line of
+// a block forms a batch; blank lines are skipped. Lines longer than a
+// block grow the buffer. Error offsets are counted from the start of the
+// stream, and line is the line number in the stream.
+class JsonLinesReader
+{
+public:
+    inline JsonLinesReader(std::istream &stream, const JsonParseOptions &options = JsonParseOptions(),
+                           size_t blockSize = JSON_LINES_BLOCK_SIZE)
+        : stream(stream), options(options), data(blockSize ? blockSize : 1, '\0')
+    {
+        // Values outlive the block they were parsed from, which is
+        // moved and refilled.
+        this->options.zeroCopy = false;
+    }
+
+    // Parses the next document into value, which the caller then owns.
+    // Returns false at the end of the stream or on a parse error.
+    inline bool next(JsonData *&value)
+    {
+        value = nullptr;
+
+        if (!result.ok())
+            return false;
+
+        for (;;)
+        {
+            if (lineIndex == lines.size() && !fillBatch())
+                return false;
+
+            Line &line = lines[lineIndex++];
+            if (isBlank(line.text))
+                continue;
+
+            value = parseLine(line, result);
+            return value != nullptr;
+        }
+    }
+
+    // Calls callback with every document in order; the callback owns
+    // the value. With a pool the lines of each batch are parsed in
+    // parallel before the callbacks run. Returns false on a parse error,
+    // after the documents before it were handed out.
+    inline bool forEach(const std::function<void(JsonData *)> &callback, JsonThreadPool *pool = nullptr)
+    {
+        JsonData *value;
+
+        if (pool == nullptr || pool->size() < 2)
+        {
+            while (next(value))
+                callback(value);
+            return result.ok();
+        }
+
+        std::vector<JsonData *> values;
+        std::vector<ParseResult> results;
+
+        while (result.ok() && (lineIndex < lines.size() || fillBatch()))
+        {
+            size_t first = lineIndex;
+            size_t count = lines.size() - first;
+            size_t chunks = std::min(count, pool->size() * 4);
+
+            values.assign(count, nullptr);
+            results.assign(count, ParseResult());
+
+            pool->run(chunks, [&](size_t chunk)
+                      {
+                for (size_t i = chunk * count / chunks; i < (chunk + 1) * count / chunks; i++)
+                {
+                    if (isBlank(lines[first + i].text))
+                        continue;
+                    values[i] = parseLine(lines[first + i], results[i]);
+                    if (values[i] == nullptr)
+                        break;
+                } });
+
+            lineIndex = lines.size();
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!result.ok())
+                {
+                    delete values[i];
+                }
+                else if (values[i] != nullptr)
+                {
+                    callback(values[i]);
+                }
+                else if (!results[i].ok())
+                {
+                    result = results[i];
+                }
+            }
+        }
+
+        lastParseResult = result;
+        return result.ok();
+    }
+
+    inline const ParseResult &getResult()
+    {
+        return result;
+    }
+
+private:
+    struct Line
+    {
+        std::string_view text;
+        size_t number; // 1-based
+        size_t offset; // in the stream
     };
 
-    inline std::string emit() override
+    static inline bool isBlank(std::string_view text)
     {
-        return "null";
+        return std::all_of(text.begin(), text.end(), isWhitespace);
     }
 
-private:
-    StringBuffer &buffer;
-};
-
-class JsonArray : public JsonData
-{
-public:
-    inline JsonArray() : buffer(emptyBuffer){};
-
-    inline JsonArray(StringBuffer &buffer) : buffer(buffer)
+    inline JsonData *parseLine(const Line &line, ParseResult &lineResult)
     {
+        StringBuffer buffer(line.text, options);
+        JsonData *value = parseJSON(buffer);
 
-        buffer.skipWhitespace(); // skip whitespace
-
-        if (buffer.next() != '[')
+        if (value == nullptr)
         {
-            parseError = true;
-            parseErrorString = "Error parsing array";
-            return;
+            lineResult = buffer.getResult();
+            lineResult.offset += line.offset;
+            lineResult.line = line.number;
         }
 
-        buffer.skipWhitespace(); // skip whitespace
+        return value;
+    }
+
+    // Collects the complete lines of the next block into lines. Reads
+    // until at least one line is complete or the stream ends.
+    inline bool fillBatch()
+    {
+        lines.clear();
+        lineIndex = 0;
 
-        while (buffer.peek() != ']')
+        for (;;)
         {
-            data.push_back(parseToJsonData(buffer));
-            if (parseError)
-            {
-                parseErrorString = "Error parsing array";
-                return;
-            }
-            buffer.skipWhitespace(); // skip whitespace
+            const char *base = data.data();
+            const char *newline;
 
-            if (buffer.peek() == ',')
-            {
-                buffer.next();
-            }
-            else if (buffer.peek() != ']')
+            while ((newline = (const char *)memchr(base + start, '\n', size - start)) != nullptr)
             {
-                parseError = true;
-                parseErrorString = "Error parsing array";
-                return;
+                size_t end = newline - base;
+                lines.push_back(Line{std::string_view(base + start, end - start), ++lineCount, streamOffset + start});
+                start = end + 1;
             }
-            else
+
+            if (!lines.empty())
+                return true;
+
+            if (eof)
             {
-                break;
+                if (start == size)
+                    return false;
+                lines.push_back(Line{std::string_view(base + start, size - start), ++lineCount, streamOffset + start});
+                start = size;
+                return true;
             }
 
-            buffer.skipWhitespace();
+            memmove(&data[0], &data[start], size - start);
+            streamOffset += start;
+            size -= start;
+            start = 0;
+
+            if (size == data.size())
+                data.resize(data.size() * 2);
+
+            stream.read(&data[size], data.size() - size);
+            size += stream.gcount();
+            eof = !stream;
         }
+    }
 
-        buffer.next(); // skip ']'
-    };
+    std::istream &stream;
+    JsonParseOptions options;
+    std::string data;
+    size_t start = 0;
+    size_t size = 0;
+    size_t streamOffset = 0;
+    size_t lineCount = 0;
+    bool eof = false;
+    std::vector<Line> lines;
+    size_t lineIndex = 0;
+    ParseResult result;
+};
 
-    inline std::vector<JsonData *> *asArray() override
-    {
-        return &data;
-    };
+inline bool JSON_lines(std::istream &stream, const std::function<void(JsonData *)> &callback,
+                       const JsonParseOptions &options, ParseResult &result, JsonThreadPool *pool = nullptr)
+{
+    JsonLinesReader reader(stream, options);
+    bool ok = reader.forEach(callback, pool);
+    result = reader.getResult();
+    return ok;
+}
 
-    inline JsonData *operator[](int index) override
-    {
-        return data[index];
-    };
+inline bool JSON_lines(std::istream &stream, const std::function<void(JsonData *)> &callback, ParseResult &result,
+                       JsonThreadPool *pool = nullptr)
+{
+    return JSON_lines(stream, callback, JsonParseOptions(), result, pool);
+}
 
-    inline JsonData *get(int index) override
-    {
-        return data[index];
-    };
+inline bool JSON_lines(std::istream &stream, const std::function<void(JsonData *)> &callback, JsonThreadPool *pool = nullptr)
+{
+    ParseResult result;
+    return JSON_lines(stream, callback, result, pool);
+}
 
-    inline JsonType getType() override
+// Incremental parser for input that arrives in pieces, e.g. an HTTP body
+// read from a socket. Chunks may split the input anywhere, including in
+// the middle of a string or number. Open containers live on an explicit
+// stack rather than the call stack, and every completed top level value
+// is handed to the callback, which owns it. Whitespace separated top
+// level values are accepted one after another.
+class JsonPushParser
+{
+public:
+    inline JsonPushParser(std::function<void(JsonData *)> callback, const JsonParseOptions &options = JsonParseOptions())
+        : callback(std::move(callback)), options(options)
     {
-        return JsonType::JSON_ARRAY;
-    };
+        // Tokens are parsed out of a scratch buffer that is reused.
+        this->options.zeroCopy = false;
+    }
 
-    inline int size() override
-    {
-        return data.size();
-    };
+    JsonPushParser(const JsonPushParser &) = delete;
+    JsonPushParser &operator=(const JsonPushParser &) = delete;
 
-    inline void push(JsonData *data) override
+    inline ~JsonPushParser()
     {
-        this->data.push_back(data);
-    };
+        if (!stack.empty())
+            delete stack.front().container;
+    }
 
-    inline JsonData *pop() override
+    // Consumes the next chunk of input. Returns false once the input is
+    // known to be invalid.
+    inline bool feed(std::string_view chunk)
     {
-        JsonData *data = this->data.back();
-        this->data.pop_back();
-        return data;
-    };
+        const char *p = chunk.data();
+        const char *end = p + chunk.size();
+        chunkBase = consumed;
+        chunkStart = p;
 
-    inline ~JsonArray() override
-    {
-        for (auto &d : data)
+        while (p < end && result.ok())
         {
-            delete d;
-        }
-    };
+            if (state == State::STRING)
+            {
+                if (escaped)
+                {
+                    token += *p++;
+                    escaped = false;
+                    continue;
+                }
+
+                const char *stop = findQuoteOrBackslash(p, end, quote);
+                countLines(p, stop);
+                token.append(p, stop);
+                p = stop;
+
+                if (p == end)
+                    break;
+
+                token += *p;
+                escaped = *p++ == '\\';
+                if (!escaped)
+                    completeString();
+                continue;
+            }
 
-    inline std::string emit() override
-    {
-        std::string str = "[";
-        for (int i = 0; i < data.size(); i++)
-        {
-            str += data[i]->emit();
-            if (i != data.size() - 1)
-                str += ",";
-        }
-        str += "]";
-        return str;
-    }
+            if (state == State::SCALAR)
+            {
+                if (!isDelimiter(*p))
+                {
+                    token += *p++;
+                    continue;
+                }
+                completeScalar();
+                continue;
+            }
 
-private:
-    StringBuffer &buffer;
-    std::vector<JsonData *> data;
-};
+            char c = *p;
 
-class JsonObject : public JsonData
-{
+            if (isWhitespace(c))
+            {
+                countLines(p, p + 1);
+                p++;
+                continue;
+            }
 
-public:
-    inline JsonObject() : buffer(emptyBuffer){};
+            handle(c, offsetOf(p));
+            p++;
+        }
 
-    inline JsonObject(StringBuffer &buffer) : buffer(buffer)
-    {
-        parseObject(buffer);
-    };
+        consumed += chunk.size();
+        return result.ok();
+    }
 
-    inline JsonData *operator[](const std::string &key) override
+    inline bool feed(const char *data, size_t size)
     {
-        return data[key];
-    };
+        return feed(std::string_view(data, size));
+    }
 
-    inline JsonData *get(const std::string &key) override
+    // Marks the end of the input. A trailing top level number or literal
+    // is completed; an unfinished value is an error.
+    inline bool finish()
     {
-        return data[key];
-    };
+        if (!result.ok())
+            return false;
 
-    inline JsonData *set(const std::string &key, JsonData *value) override
+        if (state == State::SCALAR)
+            completeScalar();
+
+        if (result.ok() && (state == State::STRING || !stack.empty()))
+            fail(JsonError::INVALID_CHARACTER, "Unexpected end of input", consumed);
+
+        lastParseResult = result;
+        return result.ok();
+    }
+
+    inline const ParseResult &getResult()
     {
-        data[key] = value;
-        return value;
-    };
+        return result;
+    }
 
-    inline JsonType getType() override
+    // Number of containers currently open.
+    inline size_t depth()
     {
-        return JsonType::JSON_OBJECT;
-    };
+        return stack.size();
+    }
 
-    inline int size() override
+private:
+    enum class State
     {
-        return data.size();
+        VALUE,       // a value, or a closing bracket when allowClose
+        KEY,         // an object key, or '}' when allowClose
+        COLON,       // ':' after a key
+        AFTER_VALUE, // ',' or the closing bracket of the open container
+        STRING,      // inside a string token
+        SCALAR       // inside a number or literal token
     };
 
-    inline JsonObject *asObject() override
+    struct Frame
     {
-        return this;
+        JsonData *container;
+        bool isObject;
+        std::string key;
     };
 
-    inline ~JsonObject() override
+    inline size_t offsetOf(const char *p)
     {
-        for (auto &d : data)
-        {
-            delete d.second;
-        }
-    };
+        return chunkBase + (p - chunkStart);
+    }
 
-    inline std::string emit() override
+    inline void countLines(const char *begin, const char *end)
     {
-        std::string str = "{";
-        int i = 0;
-        for (auto &d : data)
+        for (const char *p = begin; p < end; p++)
         {
-            str += "\"" + d.first + "\":" + d.second->emit();
-            if (i != data.size() - 1)
-                str += ",";
-            i++;
+            if (*p == '\n')
+            {
+                line++;
+                lineStart = offsetOf(p) + 1;
+            }
         }
-        str += "}";
-        return str;
     }
 
-private:
-    inline void parseObject(StringBuffer &buffer)
+    inline void fail(JsonError error, std::string message, size_t offset)
     {
+        if (!result.ok())
+            return;
+        result.error = error;
+        result.offset = offset;
+        result.line = line;
+        result.column = offset >= lineStart ? offset - lineStart + 1 : 1;
+        result.message = std::move(message);
+        lastParseResult = result;
+    }
 
-        buffer.skipWhitespace(); // skip whitespace
+    inline void handle(char c, size_t offset)
+    {
+        bool closing = c == ']' || c == '}';
 
-        if (buffer.next() != '{')
+        if (closing && (state == State::AFTER_VALUE || (allowClose && (state == State::VALUE || state == State::KEY))))
         {
-            parseError = true;
-            parseErrorString = "Error parsing object. Expected {";
+            if (stack.empty() || stack.back().isObject != (c == '}'))
+            {
+                fail(JsonError::INVALID_CHARACTER, "Unexpected closing bracket", offset);
+                return;
+            }
+            JsonData *container = stack.back().container;
+            stack.pop_back();
+            if (stack.empty())
+                emitValue(container);
+            else
+                state = State::AFTER_VALUE;
             return;
         }
 
-        buffer.skipWhitespace(); // skip whitespace
-
-        while (buffer.peek() != '}')
+        switch (state)
         {
-            std::string key = parseString(buffer);
-            if (parseError)
+        case State::VALUE:
+            if ((c == '{' || c == '[') && stack.size() >= options.maxDepth)
             {
-                parseErrorString = printf("Error parsing object. Invalid Key. | %s", parseErrorString.data());
-                return;
+                fail(JsonError::DEPTH_EXCEEDED, "Maximum nesting depth of " + std::to_string(options.maxDepth) + " exceeded", offset);
             }
-
-            buffer.skipWhitespace(); // skip whitespace
-
-            if (buffer.next() != ':')
+            else if (c == '{' || c == '[')
             {
-                parseError = true;
-                parseErrorString = "Error parsing object. Expected ':' character between key and value.";
-                return;
+                JsonData *container = c == '{' ? (JsonData *)new JsonObject() : (JsonData *)new JsonArray();
+                if (!stack.empty())
+                    attach(container);
+                stack.push_back(Frame{container, c == '{', std::string()});
+                state = c == '{' ? State::KEY : State::VALUE;
+                allowClose = true;
             }
-
-            buffer.skipWhitespace(); // skip whitespace
-
-            data[key] = parseToJsonData(buffer);
-            if (parseError)
+            else if (c == '"' || c == '\'')
             {
-                parseErrorString = printf("Error parsing object. Value error for key=[%s]. | %s", key.data(), parseErrorString.data());
-                return;
+                // Quoted like keys. The regular parser then rejects a
+                // single quoted value just as JSON() does.
+                startToken(State::STRING, c, offset);
+                tokenIsKey = false;
+            }
+            else if (closing || c == ',' || c == ':')
+            {
+                fail(JsonError::INVALID_CHARACTER, "Invalid character found: " + std::string(1, c), offset);
+            }
+            else
+            {
+                startToken(State::SCALAR, c, offset);
             }
+            break;
 
-            buffer.skipWhitespace(); // skip whitespace
+        case State::KEY:
+            if (c == '"' || c == '\'')
+            {
+                startToken(State::STRING, c, offset);
+                tokenIsKey = true;
+            }
+            else
+            {
+                fail(JsonError::INVALID_OBJECT, "Error parsing object. Invalid Key.", offset);
+            }
+            break;
 
-            if (buffer.peek() == ',')
+        case State::COLON:
+            if (c == ':')
             {
-                buffer.next();
+                state = State::VALUE;
+                allowClose = false;
             }
-            else if (buffer.peek() != '}')
+            else
             {
-                parseError = true;
-                parseErrorString = "Error parsing object. Expected ending '}'";
-                return;
+                fail(JsonError::INVALID_OBJECT, "Error parsing object. Expected ':' character between key and value.", offset);
+            }
+            break;
+
+        case State::AFTER_VALUE:
+            if (c == ',')
+            {
+                state = stack.back().isObject ? State::KEY : State::VALUE;
+                allowClose = true;
             }
             else
             {
-                break;
+                fail(stack.back().isObject ? JsonError::INVALID_OBJECT : JsonError::INVALID_ARRAY,
+                     "Expected ',' or the end of the container", offset);
             }
+            break;
 
-            buffer.skipWhitespace();
+        default:
+            break;
         }
+    }
 
-        buffer.next(); // skip '}'
+    inline void startToken(State tokenState, char c, size_t offset)
+    {
+        state = tokenState;
+        quote = c;
+        token.assign(1, c);
+        tokenStart = offset;
     }
 
-    StringBuffer &buffer;
-    std::map<std::string, JsonData *> data;
-};
+    inline void completeString()
+    {
+        if (tokenIsKey)
+        {
+            StringBuffer buffer(token, options);
+            std::string_view raw;
+            bool hasEscapes;
+            if (!scanString(buffer, raw, hasEscapes))
+            {
+                const ParseResult &error = buffer.getResult();
+                fail(error.error, error.message, tokenStart + error.offset);
+                return;
+            }
 
-#define JSON_DATA_CASE(value, type) \
-    case value:                     \
-        return new type(buffer);
+            size_t errorOffset;
+            if (!decodeString(raw, stack.back().key, errorOffset))
+            {
+                fail(JsonError::INVALID_STRING, "Error parsing string. Invalid escape sequence", tokenStart + 1 + errorOffset);
+                return;
+            }
+            state = State::COLON;
+            return;
+        }
 
-inline JsonData *parseToJsonData(StringBuffer &buffer)
-{
+        completeToken();
+    }
 
-    parseError = false;
+    inline void completeScalar()
+    {
+        completeToken();
+    }
+
+    // Parses the finished token with the regular parser.
+    inline void completeToken()
+    {
+        StringBuffer buffer(token, options);
+        JsonData *value = parseToJsonData(buffer);
 
-    buffer.skipWhitespace(); // skip whitespace
+        if (buffer.failed())
+        {
+            delete value;
+            const ParseResult &error = buffer.getResult();
+            fail(error.error, error.message, tokenStart + error.offset);
+            return;
+        }
 
-    char next = buffer.peek();
+        addValue(value);
+    }
 
-    switch (next)
+    // Adds a container to its parent as soon as it is opened, so the
+    // bottom frame owns everything built so far.
+    inline void attach(JsonData *value)
     {
-        JSON_DATA_CASE('"', JsonString);
-        JSON_DATA_CASE('t', JsonBool);
-        JSON_DATA_CASE('f', JsonBool);
-        JSON_DATA_CASE('n', JsonNull);
-        JSON_DATA_CASE('{', JsonObject);
-        JSON_DATA_CASE('[', JsonArray);
-        JSON_DATA_CASE('-', JsonNumber);
-        JSON_DATA_CASE('0', JsonNumber);
-        JSON_DATA_CASE('1', JsonNumber);
-        JSON_DATA_CASE('2', JsonNumber);
-        JSON_DATA_CASE('3', JsonNumber);
-        JSON_DATA_CASE('4', JsonNumber);
-        JSON_DATA_CASE('5', JsonNumber);
-        JSON_DATA_CASE('6', JsonNumber);
-        JSON_DATA_CASE('7', JsonNumber);
-        JSON_DATA_CASE('8', JsonNumber);
-        JSON_DATA_CASE('9', JsonNumber);
-
-    default:
-        parseError = true;
-        parseErrorString = printf("Invalid character found: %c", next);
-        return nullptr;
+        Frame &frame = stack.back();
+        if (frame.isObject)
+            frame.container->set(frame.key, value);
+        else
+            frame.container->push(value);
     }
-}
 
-inline JsonData *JSON(const std::string &str)
-{
-    StringBuffer buffer(str);
-    return parseToJsonData(buffer);
-}
+    inline void addValue(JsonData *value)
+    {
+        if (stack.empty())
+        {
+            emitValue(value);
+            return;
+        }
 
-inline JsonData *JSON(const char *str)
-{
-    std::string s(str);
-    StringBuffer buffer(s);
-    return parseToJsonData(buffer);
-}
+        attach(value);
+        state = State::AFTER_VALUE;
+    }
 
-inline JsonData *JSON(const char *str, int len)
-{
+    inline void emitValue(JsonData *value)
+    {
+        state = State::VALUE;
+        allowClose = false;
+        callback(value);
+    }
 
-    std::string s(str, len);
-    StringBuffer buffer(s);
-    return parseToJsonData(buffer);
-}
+    std::function<void(JsonData *)> callback;
+    JsonParseOptions options;
+    std::vector<Frame> stack;
+    State state = State::VALUE;
+    bool allowClose = false;
+    bool tokenIsKey = false;
+    bool escaped = false;
+    char quote = '"';
+    std::string token;
+    size_t tokenStart = 0;
+    size_t consumed = 0;
+    size_t chunkBase = 0;
+    const char *chunkStart = nullptr;
+    size_t line = 1;
+    size_t lineStart = 0;
+    ParseResult result;
+};
 
-inline JsonData *JSON(std::ifstream &file)
+inline JsonData *toJsonData(const std::string &str)
 {
-    std::string str((std::istreambuf_iterator<char>(file)),
-                    std::istreambuf_iterator<char>());
-    StringBuffer buffer(str);
-    return parseToJsonData(buffer);
+    return new JsonString(str);
 }
 
-inline JsonData *JSON(std::istream &stream)
+inline JsonData *toJsonData(const char *str)
 {
-    std::string str((std::istreambuf_iterator<char>(stream)),
-                    std::istreambuf_iterator<char>());
-    StringBuffer buffer(str);
-    return parseToJsonData(buffer);
+    return new JsonString(str);
 }
 
-inline JsonData *JSON_loadf(std::string filename)
+inline JsonData *toJsonData(double number)
 {
-    std::ifstream file(filename);
-    return JSON(file);
+    return new JsonNumber(number);
 }
 
-inline void JSON_dumpf(JsonData *data, std::string filename)
+// Any integer type other than bool, kept exact as an int64 or uint64 so
+// that toJsonData(1LL) or toJsonData(size_t) is not ambiguous.
+template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+inline JsonData *toJsonData(T number)
 {
-    std::ofstream file(filename);
-    file << data->emit();
-    file.close();
+    if constexpr (std::is_signed<T>::value)
+        return new JsonNumber((int64_t)number);
+    else
+        return new JsonNumber((uint64_t)number);
 }
 
-inline std::string JSON_emit(JsonData *data)
+inline JsonData *toJsonData(bool boolean)
 {
-    return data->emit();
+    return new JsonBool(boolean);
 }
 
-JsonData *toJsonData(const std::string &str)
+// Owning handle to a heap allocated tree, such as the ones JSON() and
+// toJsonData() return. Moving it moves a pointer; destroying it deletes
+// the tree. Nodes of a JsonDocument belong to its arena and must not be
+// wrapped.
+class Json
 {
-    return new JsonString(str);
-}
+public:
+    inline Json(){};
+
+    inline explicit Json(JsonData *data) : data(data){};
+
+    Json(Json &&) = default;
+    Json &operator=(Json &&) = default;
+
+    inline JsonData *get() const
+    {
+        return data.get();
+    }
+
+    inline JsonData *operator->() const
+    {
+        return data.get();
+    }
+
+    inline JsonData &operator*() const
+    {
+        return *data;
+    }
+
+    inline explicit operator bool() const
+    {
+        return data != nullptr;
+    }
 
-JsonData *toJsonData(const char *str)
+    // Gives up ownership; the caller deletes the tree.
+    inline JsonData *release()
+    {
+        return data.release();
+    }
+
+    inline void reset(JsonData *value = nullptr)
+    {
+        data.reset(value);
+    }
+
+private:
+    std::unique_ptr<JsonData> data;
+};
+
+inline JsonData *JsonData::set(const std::string &key, Json &&value)
 {
-    return new JsonString(str);
+    if (!value || getType() != JsonType::JSON_OBJECT)
+        return nullptr;
+    return set(key, value.release());
 }
 
-JsonData *toJsonData(double number)
+inline JsonData *JsonData::set(int index, Json &&value)
 {
-    return new JsonNumber(number);
+    if (!value || set(index, value.get()) == nullptr)
+        return nullptr;
+    return value.release();
 }
 
-JsonData *toJsonData(int number)
+inline bool JsonData::push(Json &&value)
 {
-    return new JsonNumber(number);
+    if (!value || getType() != JsonType::JSON_ARRAY)
+        return false;
+    push(value.release());
+    return true;
 }
 
-JsonData *toJsonData(bool boolean)
+inline Json JsonData::take()
 {
-    return new JsonBool(boolean);
+    return Json(pop());
 }
 
 #undef JSON_DATA_CASE
@@ -0,0 +1,323 @@
+// Throughput benchmark for the parser and emitter.
+//
+//   g++ -std=c++17 -O2 json_bench.cpp -o json_bench -lpthread
+//   ./json_bench [megabytes per corpus] [iterations]
+//
+// Generates one corpus per common document shape and reports, for JSON(),
+// JSON_emit and JSON_loadf, the best throughput over the iterations, the
+// time per value, the allocations per document and the peak resident set
+// size of the process so far. NDJSON goes through JSON_lines instead of
+// JSON() and JSON_loadf.
+
+#include "json.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Every allocation of the process goes through these, so the counter
+// covers the parser's containers and strings as well as its nodes.
+static std::atomic<size_t> allocations(0);
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+// GCC 11+ sees free() on memory from operator new once these are inlined;
+// the pair above is malloc based, so the match is right.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// Deterministic so that runs can be compared.
+class Random
+{
+public:
+    inline Random(uint64_t seed) : state(seed){};
+
+    inline uint64_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    inline int range(int n)
+    {
+        return (int)(next() % (uint64_t)n);
+    }
+
+private:
+    uint64_t state;
+};
+
+std::string randomWord(Random &random, int length)
+{
+    std::string word;
+    for (int i = 0; i < length; i++)
+        word += (char)('a' + random.range(26));
+    return word;
+}
+
+std::string numericCorpus(size_t size)
+{
+    Random random(1);
+    std::string json = "[";
+    while (json.size() < size)
+    {
+        if (random.range(2))
+            json += std::to_string((int64_t)(random.next() >> 20) - (1LL << 43));
+        else
+            json += std::to_string((double)random.next() / 1e15);
+        json += ",";
+    }
+    json += "0]";
+    return json;
+}
+
+std::string stringCorpus(size_t size)
+{
+    Random random(2);
+    std::string json = "[";
+    while (json.size() < size)
+    {
+        json += "{\"id\":\"" + randomWord(random, 12) + "\",\"text\":\"";
+        for (int words = 10 + random.range(40); words > 0; words--)
+            json += randomWord(random, 1 + random.range(10)) + " ";
+        json += "\",\"tag\":\"" + randomWord(random, 6) + "\"},";
+    }
+    json += "{}]";
+    return json;
+}
+
+std::string nestedCorpus(size_t size)
+{
+    Random random(3);
+    std::string json = "[";
+    while (json.size() < size)
+    {
+        std::string closing;
+        for (int depth = 20 + random.range(80); depth > 0; depth--)
+        {
+            bool isObject = random.range(2);
+            json += isObject ? "{\"k\":" : "[";
+            closing += isObject ? '}' : ']';
+        }
+        json += std::to_string(random.range(1000));
+        json.append(closing.rbegin(), closing.rend());
+        json += ",";
+    }
+    json += "0]";
+    return json;
+}
+
+std::string wideCorpus(size_t size)
+{
+    Random random(4);
+    std::string json = "[";
+    while (json.size() < size)
+    {
+        json += "{";
+        for (int i = 0; i < 1000; i++)
+        {
+            if (i)
+                json += ",";
+            json += "\"" + randomWord(random, 4) + std::to_string(i) + "\":" + std::to_string(random.range(100000));
+        }
+        json += "},";
+    }
+    json += "{}]";
+    return json;
+}
+
+std::string ndjsonCorpus(size_t size)
+{
+    Random random(5);
+    std::string json;
+    while (json.size() < size)
+    {
+        json += "{\"id\":" + std::to_string(random.next() >> 40) + ",\"user\":\"" + randomWord(random, 8) +
+                "\",\"score\":" + std::to_string(random.range(10000) / 100.0) + ",\"tags\":[\"" +
+                randomWord(random, 5) + "\",\"" + randomWord(random, 5) + "\"],\"ok\":true}\n";
+    }
+    return json;
+}
+
+size_t countValues(JsonData *data)
+{
+    size_t count = 1;
+    if (data->getType() == JsonType::JSON_ARRAY)
+    {
+        for (JsonData *element : *data->asArray())
+            count += countValues(element);
+    }
+    else if (data->getType() == JsonType::JSON_OBJECT)
+    {
+        for (auto &member : *data->asObject())
+            count += countValues(member.value);
+    }
+    return count;
+}
+
+double peakRssMegabytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#else
+    return 0;
+#endif
+}
+
+struct Measurement
+{
+    double seconds = 1e300;
+    size_t allocations = 0;
+};
+
+// Runs operation iterations times, keeping the fastest run and the
+// allocations made by one run.
+template <typename Operation>
+Measurement measure(int iterations, Operation operation)
+{
+    Measurement result;
+    for (int i = 0; i < iterations; i++)
+    {
+        size_t before = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.allocations = allocations.load() - before;
+        if (seconds < result.seconds)
+            result.seconds = seconds;
+    }
+    return result;
+}
+
+void report(const std::string &corpus, const std::string &operation, size_t bytes, size_t values,
+            size_t documents, const Measurement &measurement)
+{
+    printf("%-10s %-12s %10.1f %12.1f %14.1f %12.1f\n", corpus.c_str(), operation.c_str(),
+           bytes / measurement.seconds / 1e6, measurement.seconds * 1e9 / values,
+           (double)measurement.allocations / documents, peakRssMegabytes());
+}
+
+void benchDocument(const std::string &name, const std::string &json, int iterations)
+{
+    std::string filename = "json_bench_" + name + ".json";
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file << json;
+    }
+
+    JsonData *data = JSON(json);
+    if (data == nullptr)
+    {
+        printf("%-10s failed to parse: %s\n", name.c_str(), getError().c_str());
+        return;
+    }
+    size_t values = countValues(data);
+
+    report(name, "JSON()", json.size(), values, 1, measure(iterations, [&]
+                                                           { delete JSON(json); }));
+
+    std::string emitted;
+    report(name, "JSON_emit", json.size(), values, 1, measure(iterations, [&]
+                                                              { emitted = JSON_emit(data); }));
+
+    report(name, "JSON_loadf", json.size(), values, 1, measure(iterations, [&]
+                                                               { delete JSON_loadf(filename); }));
+
+    delete data;
+    std::remove(filename.c_str());
+}
+
+void benchLines(const std::string &name, const std::string &json, int iterations)
+{
+    std::string filename = "json_bench_" + name + ".json";
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file << json;
+    }
+
+    std::vector<JsonData *> documents;
+    size_t values = 0;
+    {
+        std::istringstream stream(json);
+        JSON_lines(stream, [&](JsonData *data)
+                   { values += countValues(data); documents.push_back(data); });
+    }
+
+    report(name, "JSON_lines", json.size(), values, documents.size(), measure(iterations, [&]
+                                                                              {
+        std::istringstream stream(json);
+        JSON_lines(stream, [](JsonData *data) { delete data; }); }));
+
+    std::string emitted;
+    report(name, "JSON_emit", json.size(), values, documents.size(), measure(iterations, [&]
+                                                                             {
+        emitted.clear();
+        for (JsonData *data : documents)
+            emitted += JSON_emit(data) + "\n"; }));
+
+    report(name, "lines file", json.size(), values, documents.size(), measure(iterations, [&]
+                                                                              {
+        std::ifstream stream(filename, std::ios::binary);
+        JSON_lines(stream, [](JsonData *data) { delete data; }); }));
+
+    for (JsonData *data : documents)
+        delete data;
+    std::remove(filename.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+    size_t size = megabytes << 20;
+
+    printf("%-10s %-12s %10s %12s %14s %12s\n", "corpus", "operation", "MB/s", "ns/value", "allocs/doc", "peak RSS MB");
+
+    benchDocument("numeric", numericCorpus(size), iterations);
+    benchDocument("strings", stringCorpus(size), iterations);
+    benchDocument("nested", nestedCorpus(size), iterations);
+    benchDocument("wide", wideCorpus(size), iterations);
+    benchLines("ndjson", ndjsonCorpus(size), iterations);
+
+    return 0;
+}
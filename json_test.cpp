@@ -1,6 +1,17 @@
 #include "unit_test_framework.h"
 #include "json.h"
 
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <sstream>
+
+// Scratch files go to the system temp directory, not the working tree.
+static std::string tempPath(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
 TEST(parse_string_test)
 {
     std::string str = "\"hello world\"";
@@ -15,7 +26,7 @@ TEST(parse_string_test_2)
     std::cout << str << std::endl;
     StringBuffer buffer(str);
     std::string value = parseString(buffer);
-    ASSERT_EQUAL(value, "hello \\\"world\\n\\\"");
+    ASSERT_EQUAL(value, "hello \"world\n\"");
 }
 
 
@@ -67,6 +78,53 @@ TEST(parse_number_negative_3)
     ASSERT_EQUAL(value, -0.123);
 }
 
+TEST(parse_number_exponent)
+{
+    std::string str = "-1.5e3";
+    StringBuffer buffer(str);
+    double value = parseNumber(buffer);
+    ASSERT_EQUAL(value, -1500);
+
+    std::string str2 = "2E-2";
+    StringBuffer buffer2(str2);
+    ASSERT_EQUAL(parseNumber(buffer2), 0.02);
+}
+
+TEST(parse_number_token_exact_integer)
+{
+    std::string str = "18446744073709551615";
+    StringBuffer buffer(str);
+    JsonNumberToken number;
+
+    ASSERT_TRUE(parseNumberToken(buffer, number));
+    ASSERT_TRUE(number.isInteger);
+    ASSERT_EQUAL(number.integer, 18446744073709551615ULL);
+
+    std::string str2 = "-9007199254740993";
+    StringBuffer buffer2(str2);
+    ASSERT_TRUE(parseNumberToken(buffer2, number));
+    ASSERT_TRUE(number.isInteger && number.isNegative);
+    ASSERT_EQUAL(number.integer, 9007199254740993ULL);
+
+    std::string str3 = "184467440737095516160";
+    StringBuffer buffer3(str3);
+    ASSERT_TRUE(parseNumberToken(buffer3, number));
+    ASSERT_FALSE(number.isInteger);
+    ASSERT_EQUAL(number.real, 184467440737095516160.0);
+}
+
+TEST(parse_number_invalid)
+{
+    const char *invalid[] = {"1.2.3", "12abc", "-", "1.", "1e", "--1"};
+    for (const char *str : invalid)
+    {
+        StringBuffer buffer(str);
+        parseNumber(buffer);
+        ASSERT_TRUE(buffer.failed());
+        ASSERT_TRUE(buffer.getResult().error == JsonError::INVALID_NUMBER);
+    }
+}
+
 TEST(parse_boolean)
 {
     std::string str = "true";
@@ -105,6 +163,74 @@ TEST(parse_json_number)
     delete value;
 }
 
+TEST(parse_json_number_lossless_integers)
+{
+    JsonData *value = JSON("[9007199254740993, -9223372036854775808, 18446744073709551615, 1.5, -0]");
+
+    ASSERT_TRUE(value->get(0)->isInteger());
+    ASSERT_EQUAL(value->get(0)->asInt64(), 9007199254740993LL);
+    ASSERT_EQUAL(value->get(1)->asInt64(), INT64_MIN);
+    ASSERT_EQUAL(value->get(2)->asUint64(), UINT64_MAX);
+    ASSERT_FALSE(value->get(3)->isInteger());
+    ASSERT_EQUAL(value->get(3)->asNumber(), 1.5);
+    ASSERT_FALSE(value->get(4)->isInteger());
+
+    ASSERT_EQUAL(value->get(0)->emit(), "9007199254740993");
+    ASSERT_EQUAL(value->get(1)->emit(), "-9223372036854775808");
+    ASSERT_EQUAL(value->get(2)->emit(), "18446744073709551615");
+
+    delete value;
+}
+
+TEST(json_number_emit_shortest)
+{
+    double values[] = {0.1, 123.456, -0.123, 1e21, 5e-324, 1.7976931348623157e308, 2.0 / 3.0};
+
+    for (double v : values)
+    {
+        JsonData *number = toJsonData(v);
+        std::string text = number->emit();
+        StringBuffer buffer(text);
+        ASSERT_EQUAL(parseNumber(buffer), v);
+        delete number;
+    }
+
+    JsonData *a = toJsonData(0.1);
+    JsonData *b = toJsonData(123.0);
+    JsonData *c = toJsonData(std::nan(""));
+    ASSERT_EQUAL(a->emit(), "0.1");
+    ASSERT_EQUAL(b->emit(), "123");
+    ASSERT_EQUAL(c->emit(), "null");
+
+    delete a;
+    delete b;
+    delete c;
+}
+
+TEST(json_number_from_integers)
+{
+    JsonData *a = toJsonData(123);
+    JsonData *b = toJsonData((int64_t)1 << 62);
+    JsonData *c = toJsonData(UINT64_MAX);
+    JsonData *d = toJsonData(-1LL);
+    JsonData *e = toJsonData((size_t)7);
+    JsonData *f = toJsonData((short)-2);
+
+    ASSERT_EQUAL(a->emit(), "123");
+    ASSERT_EQUAL(b->asInt64(), (int64_t)1 << 62);
+    ASSERT_EQUAL(c->emit(), "18446744073709551615");
+    ASSERT_EQUAL(d->emit(), "-1");
+    ASSERT_EQUAL(e->emit(), "7");
+    ASSERT_EQUAL(f->emit(), "-2");
+
+    delete a;
+    delete b;
+    delete c;
+    delete d;
+    delete e;
+    delete f;
+}
+
 TEST(parse_json_string)
 {
 
@@ -172,6 +298,11 @@ TEST(parse_json_array)
     ASSERT_EQUAL((*value->asArray())[1]->asNumber(), 2);
     ASSERT_EQUAL((*value->asArray())[2]->asNumber(), 3);
 
+    std::vector<JsonData *> elements = value->asVector();
+    ASSERT_EQUAL(elements.size(), 3);
+    ASSERT_EQUAL(elements[2]->asNumber(), 3);
+    ASSERT_TRUE(value->asVector()[0]->asVector().empty());
+
     delete value;
 }
 
@@ -307,6 +438,843 @@ TEST(parse_and_emit)
 }
 
 
+TEST(json_emit_to_stream)
+{
+    JsonArray array;
+    for (int i = 0; i < 20000; i++)
+        array.push(toJsonData("value " + std::to_string(i)));
+
+    std::ostringstream stream;
+    JSON_emit(&array, stream);
+
+    std::string expected = array.emit();
+    ASSERT_TRUE(expected.size() > JSON_WRITER_FLUSH_SIZE);
+    ASSERT_EQUAL(stream.str(), expected);
+}
+
+TEST(json_emit_to_writer)
+{
+    JsonData *value = JSON("{\"a\": [1, 2.5, true, null, \"x\"], \"b\": {}}");
+
+    JsonWriter writer;
+    JSON_emit(value, writer);
+    writer.put('\n');
+
+    ASSERT_EQUAL(writer.take(), "{\"a\":[1,2.5,true,null,\"x\"],\"b\":{}}\n");
+
+    delete value;
+}
+
+TEST(json_object_insertion_order)
+{
+    JsonData *value = JSON("{\"z\": 1, \"a\": 2, \"m\": 3, \"a\": 4}");
+
+    ASSERT_EQUAL(value->size(), 3);
+    ASSERT_EQUAL(value->get("a")->asNumber(), 4);
+    ASSERT_EQUAL(value->emit(), "{\"z\":1,\"a\":4,\"m\":3}");
+
+    delete value;
+}
+
+TEST(json_object_hashed_lookup)
+{
+    JsonObject object;
+    for (int i = 0; i < 1000; i++)
+        object.set("key" + std::to_string(i), toJsonData(i));
+
+    ASSERT_EQUAL(object.size(), 1000);
+    for (int i = 0; i < 1000; i++)
+        ASSERT_EQUAL(object.get("key" + std::to_string(i))->asInt64(), i);
+    ASSERT_TRUE(object.get("key1000") == nullptr);
+
+    int i = 0;
+    for (auto &member : object)
+        ASSERT_EQUAL(member.key->str(), "key" + std::to_string(i++));
+}
+
+TEST(json_document_interned_keys)
+{
+    std::string str = "[";
+    for (int i = 0; i < 100; i++)
+        str += std::string(i ? "," : "") + "{\"name\": \"n" + std::to_string(i) + "\", \"id\": " + std::to_string(i) + "}";
+    str += "]";
+
+    JsonDocument doc;
+    JsonData *value = doc.parse(str);
+
+    ASSERT_EQUAL(doc.keyCount(), 2);
+
+    const JsonKey *name = doc.intern("name");
+    ASSERT_EQUAL(doc.keyCount(), 2);
+    ASSERT_EQUAL(value->get(7)->get(name)->asString(), "n7");
+    ASSERT_EQUAL(value->get(42)->get("id")->asInt64(), 42);
+
+    auto first = value->get(0)->asObject()->begin();
+    auto second = value->get(1)->asObject()->begin();
+    ASSERT_TRUE(first->key == second->key);
+
+    // Objects past JSON_OBJECT_LINEAR_MAX keys are hashed.
+    std::string wide = "{";
+    for (int i = 0; i < 50; i++)
+        wide += std::string(i ? "," : "") + "\"k" + std::to_string(i) + "\": " + std::to_string(i);
+    wide += "}";
+    JsonDocument wideDoc;
+    JsonData *object = wideDoc.parse(wide);
+    ASSERT_EQUAL(object->get(wideDoc.intern("k37"))->asInt64(), 37);
+    ASSERT_TRUE(object->get(wideDoc.intern("k50")) == nullptr);
+
+    JsonDocument empty;
+    ASSERT_TRUE(empty.intern("name") == nullptr);
+
+    JsonDocument moved(std::move(doc));
+    ASSERT_TRUE(moved.intern("name") == name);
+    ASSERT_TRUE(doc.intern("name") == nullptr);
+    ASSERT_TRUE(doc.getRoot() == nullptr);
+    ASSERT_EQUAL(doc.keyCount(), 0);
+
+    doc = std::move(moved);
+    ASSERT_TRUE(doc.intern("id") != nullptr);
+    ASSERT_TRUE(moved.intern("id") == nullptr);
+    ASSERT_EQUAL(doc.getRoot()->get(3)->get(name)->asString(), "n3");
+}
+
+TEST(json_parse_result_location)
+{
+    ParseResult result;
+    JsonData *value = JSON("{\n  \"a\": [1, 2],\n  \"b\": tru\n}", result);
+
+    ASSERT_TRUE(value == nullptr);
+    ASSERT_FALSE(result.ok());
+    ASSERT_TRUE(result.error == JsonError::INVALID_BOOL);
+    ASSERT_EQUAL(result.offset, 24);
+    ASSERT_EQUAL(result.line, 3);
+    ASSERT_EQUAL(result.column, 8);
+    ASSERT_TRUE(hasError());
+    ASSERT_TRUE(getError().find("key=[b]") != std::string::npos);
+
+    JsonData *valid = JSON("[1]", result);
+    ASSERT_TRUE(result.ok());
+    ASSERT_FALSE(hasError());
+    delete valid;
+}
+
+TEST(json_parse_concurrently)
+{
+    std::vector<std::thread> threads;
+    std::vector<int> failures(8, 0);
+
+    for (int t = 0; t < 8; t++)
+    {
+        threads.emplace_back([t, &failures]()
+                             {
+            for (int i = 0; i < 200; i++)
+            {
+                bool valid = (i + t) % 2 == 0;
+                ParseResult result;
+                JsonData *value = JSON(valid ? "{\"a\": [1, 2, 3]}" : "{\"a\": [1, 2, }", result);
+                if (result.ok() != valid || (value != nullptr) != valid || hasError() == valid)
+                    failures[t]++;
+                if (!valid && result.offset != 13)
+                    failures[t]++;
+                delete value;
+            } });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    for (int failure : failures)
+        ASSERT_EQUAL(failure, 0);
+}
+
+TEST(json_thread_pool_run)
+{
+    JsonThreadPool pool(4);
+    std::vector<int> hits(1000, 0);
+
+    for (int round = 0; round < 3; round++)
+        pool.run(hits.size(), [&](size_t i)
+                 { hits[i]++; });
+
+    for (int hit : hits)
+        ASSERT_EQUAL(hit, 3);
+}
+
+TEST(json_parallel_matches_sequential)
+{
+    std::string str = "[";
+    for (int i = 0; str.size() < JSON_PARALLEL_MIN_SIZE + 1000; i++)
+    {
+        if (i)
+            str += ", ";
+        str += "{\"id\": " + std::to_string(i) + ", \"tags\": [\"a,b\", \"]\"], \"nested\": {\"x\": [1, [2, {\"y\": null}]]}}";
+    }
+    str += " ]";
+
+    JsonThreadPool pool(4);
+    ParseResult result;
+    JsonData *parallel = JSON_parallel(str, pool, JsonParseOptions(), result);
+    JsonData *sequential = JSON(str);
+
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQUAL(parallel->size(), sequential->size());
+    ASSERT_EQUAL(parallel->emit(), sequential->emit());
+
+    delete parallel;
+    delete sequential;
+
+    size_t broken = str.size() / 2;
+    while (str[broken] != ',')
+        broken++;
+    str.insert(broken + 1, "1 2");
+
+    ParseResult expected;
+    JSON(str, expected);
+    ASSERT_TRUE(JSON_parallel(str, pool, JsonParseOptions(), result) == nullptr);
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQUAL(result.offset, expected.offset);
+}
+
+TEST(json_parallel_max_depth)
+{
+    // One element nests to exactly maxDepth counting the top level array.
+    JsonParseOptions options;
+    options.maxDepth = 8;
+    std::string str = "[";
+    for (int i = 0; str.size() < JSON_PARALLEL_MIN_SIZE + 1000; i++)
+        str += std::to_string(i) + ", ";
+    str += std::string(7, '[') + std::string(7, ']') + "]";
+
+    JsonThreadPool pool(4);
+    ParseResult result;
+    JsonData *parallel = JSON_parallel(str, pool, options, result);
+    JsonData *sequential = JSON(str, options, result);
+
+    ASSERT_TRUE(parallel != nullptr);
+    ASSERT_TRUE(sequential != nullptr);
+    ASSERT_EQUAL(parallel->emit(), sequential->emit());
+
+    delete parallel;
+    delete sequential;
+
+    // One level deeper fails at the same offset as the sequential parser.
+    str.insert(str.size() - 15, "[");
+    str.insert(str.size() - 1, "]");
+
+    ParseResult expected;
+    ASSERT_TRUE(JSON(str, options, expected) == nullptr);
+    ASSERT_TRUE(JSON_parallel(str, pool, options, result) == nullptr);
+    ASSERT_TRUE(result.error == JsonError::DEPTH_EXCEEDED);
+    ASSERT_TRUE(expected.error == JsonError::DEPTH_EXCEEDED);
+    ASSERT_EQUAL(result.offset, expected.offset);
+}
+
+TEST(json_lines_reader)
+{
+    std::stringstream stream("{\"a\": 1}\n\n[1, 2]\r\n\"x\"\n  \n{\"b\": {\"c\": null}}");
+
+    JsonLinesReader reader(stream, JsonParseOptions(), 8);
+    std::vector<std::string> out;
+    JsonData *value;
+
+    while (reader.next(value))
+    {
+        out.push_back(value->emit());
+        delete value;
+    }
+
+    ASSERT_TRUE(reader.getResult().ok());
+    std::vector<std::string> expected = {"{\"a\":1}", "[1,2]", "\"x\"", "{\"b\":{\"c\":null}}"};
+    ASSERT_SEQUENCE_EQUAL(out, expected);
+}
+
+TEST(json_lines_zero_copy_small_blocks)
+{
+    std::string text;
+    for (int i = 0; i < 5000; i++)
+        text += "{\"name\": \"item " + std::to_string(i) + "\"}\n";
+
+    JsonParseOptions options;
+    options.zeroCopy = true;
+    std::stringstream stream(text);
+    JsonLinesReader reader(stream, options, 256);
+
+    // Every value is checked after the reader has moved on.
+    std::vector<JsonData *> values;
+    JsonData *value;
+    while (reader.next(value))
+        values.push_back(value);
+
+    ASSERT_TRUE(reader.getResult().ok());
+    ASSERT_EQUAL(values.size(), 5000);
+    bool intact = true;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        intact &= values[i]->get("name")->asString() == "item " + std::to_string(i);
+        delete values[i];
+    }
+    ASSERT_TRUE(intact);
+
+    std::stringstream again(text);
+    ParseResult result;
+    int count = 0;
+    ASSERT_TRUE(JSON_lines(again, [&](JsonData *value)
+                           { count++; delete value; }, options, result));
+    ASSERT_EQUAL(count, 5000);
+}
+
+TEST(json_lines_parallel_in_order)
+{
+    std::string text;
+    for (int i = 0; i < 5000; i++)
+        text += "{\"id\": " + std::to_string(i) + ", \"v\": [" + std::to_string(i * 2) + "]}\n";
+    text += "{\"id\": oops}\n[1]\n";
+
+    JsonThreadPool pool(4);
+    std::stringstream stream(text);
+    JsonLinesReader reader(stream, JsonParseOptions(), 4096);
+
+    int next = 0;
+    bool inOrder = true;
+    bool ok = reader.forEach([&](JsonData *value)
+                             {
+        inOrder &= value->get("id")->asInt64() == next++;
+        delete value; }, &pool);
+
+    ASSERT_FALSE(ok);
+    ASSERT_TRUE(inOrder);
+    ASSERT_EQUAL(next, 5000);
+    ASSERT_EQUAL(reader.getResult().line, 5001);
+    ASSERT_EQUAL(text.substr(reader.getResult().offset, 4), "oops");
+}
+
+TEST(json_loadf_mmap)
+{
+    std::string path = tempPath("json_test_mmap.json");
+    {
+        std::ofstream file(path);
+        file << "{\"name\": \"mapped\", \"list\": [1, 2, 3]}";
+    }
+
+    JsonDocument doc = JSON_loadf_mmap(path);
+
+    ASSERT_FALSE(doc.hasError());
+    ASSERT_EQUAL(doc.getRoot()->get("name")->asString(), "mapped");
+    ASSERT_EQUAL(doc.getRoot()->get("list")->size(), 3);
+
+    JsonData *value = JSON_loadf(path);
+    ASSERT_EQUAL(value->emit(), doc.getRoot()->emit());
+    delete value;
+    std::remove(path.c_str());
+
+    JsonDocument missing = JSON_loadf_mmap("does_not_exist.json");
+    ASSERT_TRUE(missing.getRoot() == nullptr);
+    ASSERT_TRUE(missing.getResult().error == JsonError::FILE_ERROR);
+    ASSERT_TRUE(JSON_loadf("does_not_exist.json") == nullptr);
+}
+
+TEST(json_push_parser)
+{
+    std::string text = "{\"name\": \"push\", \"list\": [1, -2.5, true, null, {'k': \"v\"}]} [] 42";
+    std::vector<JsonData *> values;
+
+    JsonPushParser parser([&](JsonData *value) { values.push_back(value); });
+
+    // Feed one byte at a time so every token is split across chunks.
+    for (char c : text)
+        ASSERT_TRUE(parser.feed(&c, 1));
+
+    ASSERT_EQUAL(values.size(), 2);
+    ASSERT_TRUE(parser.finish());
+    ASSERT_EQUAL(values.size(), 3);
+
+    JsonData *expected = JSON("{\"name\": \"push\", \"list\": [1, -2.5, true, null, {'k': \"v\"}]}");
+    ASSERT_EQUAL(values[0]->emit(), expected->emit());
+    ASSERT_EQUAL(values[1]->size(), 0);
+    ASSERT_EQUAL(values[2]->asInt64(), 42);
+    delete expected;
+
+    for (JsonData *value : values)
+        delete value;
+}
+
+TEST(json_push_parser_errors)
+{
+    int count = 0;
+
+    JsonPushParser parser([&](JsonData *value) { count++; delete value; });
+    ASSERT_TRUE(parser.feed("[1, 2,\n"));
+    ASSERT_EQUAL(parser.depth(), 1);
+    ASSERT_FALSE(parser.feed(" 3 4]"));
+    ASSERT_TRUE(parser.getResult().error == JsonError::INVALID_ARRAY);
+    ASSERT_EQUAL(parser.getResult().offset, 10);
+    ASSERT_EQUAL(parser.getResult().line, 2);
+    ASSERT_EQUAL(parser.getResult().column, 4);
+    ASSERT_EQUAL(count, 0);
+
+    JsonPushParser truncated([&](JsonData *value) { count++; delete value; });
+    ASSERT_TRUE(truncated.feed("{\"a\": [1, {\"b\": tr"));
+    ASSERT_FALSE(truncated.finish());
+    ASSERT_EQUAL(count, 0);
+
+    JsonPushParser literal([&](JsonData *value) { count++; delete value; });
+    ASSERT_TRUE(literal.feed("[tru"));
+    ASSERT_FALSE(literal.feed("x]"));
+    ASSERT_TRUE(literal.getResult().error == JsonError::INVALID_BOOL);
+}
+
+TEST(json_push_parser_quotes)
+{
+    // Keys and values are cut into tokens the same way for either quote,
+    // so the result matches JSON(): single quoted keys are accepted and
+    // single quoted values are not.
+    std::string key = "{'k\"x': 1}";
+    std::vector<JsonData *> values;
+    JsonPushParser parser([&](JsonData *value) { values.push_back(value); });
+    for (char c : key)
+        ASSERT_TRUE(parser.feed(&c, 1));
+    ASSERT_EQUAL(values.size(), 1);
+    ASSERT_EQUAL(values[0]->get("k\"x")->asInt64(), 1);
+    delete values[0];
+
+    std::string value = "{\"a\": 'x, y'}";
+    ASSERT_TRUE(JSON(value) == nullptr);
+    ParseResult expected = getParseResult();
+
+    int count = 0;
+    JsonPushParser rejected([&](JsonData *value) { count++; delete value; });
+    bool ok = true;
+    for (char c : value)
+        ok = ok && rejected.feed(&c, 1);
+    ASSERT_FALSE(ok);
+    ASSERT_TRUE(rejected.getResult().error == expected.error);
+    ASSERT_EQUAL(rejected.getResult().offset, expected.offset);
+    ASSERT_EQUAL(count, 0);
+}
+
+struct SaxRecorder : JsonSaxHandler
+{
+    std::string events;
+
+    bool onStartObject() { events += "{"; return true; }
+    bool onEndObject() { events += "}"; return true; }
+    bool onStartArray() { events += "["; return true; }
+    bool onEndArray() { events += "]"; return true; }
+    bool onKey(std::string_view key) { events += std::string(key) + ":"; return true; }
+    bool onString(std::string_view value) { events += "s(" + std::string(value) + ")"; return true; }
+    bool onNumber(const JsonNumberToken &number) { events += "n(" + std::to_string(number.toDouble()) + ")"; return true; }
+    bool onBool(bool value) { events += value ? "T" : "F"; return true; }
+    bool onNull() { events += "N"; return true; }
+};
+
+// Sums every "price" field and stops after the first "stop" key.
+struct SaxPriceSum : JsonSaxHandler
+{
+    double total = 0;
+    bool isPrice = false;
+
+    bool onKey(std::string_view key)
+    {
+        isPrice = key == "price";
+        return key != "stop";
+    }
+
+    bool onNumber(const JsonNumberToken &number)
+    {
+        if (isPrice)
+            total += number.toDouble();
+        isPrice = false;
+        return true;
+    }
+};
+
+TEST(json_sax_events)
+{
+    SaxRecorder recorder;
+
+    ASSERT_TRUE(JSON_sax("{\"a\": [1, \"x\", true, false, null], 'b': {}}", recorder));
+    ASSERT_EQUAL(recorder.events, "{a:[n(1.000000)s(x)TFN]b:{}}");
+
+    SaxPriceSum sum;
+    ASSERT_TRUE(JSON_sax("[{\"price\": 1.5, \"qty\": 3}, {\"price\": 2}, {\"stop\": 0}, {\"price\": 100}]", sum));
+    ASSERT_EQUAL(sum.total, 3.5);
+}
+
+TEST(json_sax_errors)
+{
+    std::string text = "{\"a\": [1, 2,, 3]}";
+    SaxRecorder recorder;
+    ParseResult result;
+
+    ASSERT_FALSE(JSON_sax(text, recorder, result));
+    ASSERT_TRUE(hasError());
+
+    ParseResult expected;
+    delete JSON(text, expected);
+    ASSERT_TRUE(result.error == expected.error);
+    ASSERT_EQUAL(result.offset, expected.offset);
+}
+
+TEST(json_lazy_lookup)
+{
+    std::string text = "{\"skip\": {\"a\": [1, \"]}\", {\"b\": 2}]}, 'name': \"lazy \\\"q\\\"\", "
+                       "\"list\": [10, -2.5, true, null, [1, 2]], \"big\": 18446744073709551615}";
+    LazyJson doc(text);
+
+    ASSERT_TRUE(doc.getType() == JsonType::JSON_OBJECT);
+    ASSERT_EQUAL(doc.size(), 4);
+    JsonData *name = JSON("\"lazy \\\"q\\\"\"");
+    ASSERT_EQUAL(doc["name"].asString(), name->asString());
+    delete name;
+    ASSERT_EQUAL(doc["list"].size(), 5);
+    ASSERT_EQUAL(doc["list"][0].asInt64(), 10);
+    ASSERT_EQUAL(doc["list"][1].asNumber(), -2.5);
+    ASSERT_TRUE(doc["list"][2].asBool());
+    ASSERT_TRUE(doc["list"][3].isNull());
+    ASSERT_EQUAL(doc["list"][4].raw(), "[1, 2]");
+    ASSERT_EQUAL(doc["skip"]["a"][2]["b"].asInt64(), 2);
+
+    ASSERT_FALSE(doc["missing"].isValid());
+    ASSERT_FALSE(doc["list"][5].isValid());
+    ASSERT_FALSE(doc["name"]["x"].isValid());
+
+    JsonData *list = doc["list"].materialize();
+    ASSERT_EQUAL(list->size(), 5);
+    ASSERT_EQUAL(list->get(4)->size(), 2);
+    delete list;
+
+    // A repeated key finds its last value, as JSON() and materialize keep it.
+    std::string repeated = "{\"a\": 1, \"b\": {\"c\": [3], \"c\": [4]}, \"a\": 2}";
+    JsonData *tree = LazyJson(repeated).materialize();
+    ASSERT_EQUAL(LazyJson(repeated)["a"].asInt64(), 2);
+    ASSERT_EQUAL(LazyJson(repeated)["a"].asInt64(), tree->get("a")->asInt64());
+    ASSERT_EQUAL(LazyJson(repeated)["b"]["c"][0].asInt64(), 4);
+    delete tree;
+
+    ASSERT_FALSE(LazyJson("{\"a\": [1, 2}")["b"].isValid());
+    ASSERT_TRUE(LazyJson("{\"a\": [1, 2").get("a").raw().empty());
+}
+
+TEST(json_pointer)
+{
+    std::string text = "{\"items\": [{\"name\": \"a\"}, {\"name\": \"b\", \"tags\": [\"x\", \"y\"]}], "
+                       "\"a/b\": 1, \"m~n\": 2, \"\": 3, \"10\": 4}";
+    JsonData *root = JSON(text);
+
+    JsonPointer tag("/items/1/tags/1");
+    ASSERT_TRUE(tag.isValid());
+    ASSERT_EQUAL(tag.size(), 4);
+    ASSERT_EQUAL(tag.evaluate(root)->asString(), "y");
+    ASSERT_TRUE(JsonPointer("").evaluate(root) == root);
+    ASSERT_EQUAL(JsonPointer("/a~1b").evaluate(root)->asInt64(), 1);
+    ASSERT_EQUAL(JsonPointer("/m~0n").evaluate(root)->asInt64(), 2);
+    ASSERT_EQUAL(JsonPointer("/").evaluate(root)->asInt64(), 3);
+    ASSERT_EQUAL(JsonPointer("/10").evaluate(root)->asInt64(), 4);
+
+    ASSERT_TRUE(JsonPointer("/items/2").evaluate(root) == nullptr);
+    ASSERT_TRUE(JsonPointer("/items/01").evaluate(root) == nullptr);
+    ASSERT_TRUE(JsonPointer("/items/-").evaluate(root) == nullptr);
+    ASSERT_TRUE(JsonPointer("/items/0/name/x").evaluate(root) == nullptr);
+    ASSERT_FALSE(JsonPointer("items").isValid());
+    ASSERT_FALSE(JsonPointer("/a~2").isValid());
+
+    // Evaluated again against another tree without reparsing the path.
+    JsonData *other = JSON("{\"items\": [0, {\"tags\": [\"p\", \"q\"]}]}");
+    ASSERT_EQUAL(tag.evaluate(other)->asString(), "q");
+    delete other;
+
+    ASSERT_EQUAL(tag.evaluate(LazyJson(text)).asString(), "y");
+    ASSERT_EQUAL(JsonPointer("/items/0").evaluate(LazyJson(text)).raw(), "{\"name\": \"a\"}");
+
+    SaxRecorder recorder;
+    ASSERT_TRUE(JSON_sax(text, JsonPointer("/items/1/tags"), recorder));
+    ASSERT_EQUAL(recorder.events, "[s(x)s(y)]");
+    ASSERT_FALSE(JSON_sax(text, JsonPointer("/missing"), recorder));
+
+    ParseResult result;
+    ASSERT_FALSE(JSON_sax("{\"a\":\n [1, x]}", JsonPointer("/a"), recorder, JsonParseOptions(), result));
+    ASSERT_EQUAL(result.offset, 11);
+    ASSERT_EQUAL(result.line, 2);
+    ASSERT_EQUAL(result.column, 6);
+
+    delete root;
+}
+
+TEST(json_compact_value)
+{
+    std::string text = "{\"short\": \"abc\", \"long\": \"a string longer than fourteen bytes\", "
+                       "\"numbers\": [0, -9223372036854775808, 18446744073709551615, 2.5, -0.0], "
+                       "\"flags\": [true, false, null], \"nested\": {\"empty\": [], \"obj\": {}}}";
+    JsonCompactDocument doc = JSON_compact(text);
+
+    ASSERT_EQUAL(sizeof(JsonValue), 16);
+    ASSERT_FALSE(doc.hasError());
+
+    const JsonValue *root = doc.getRoot();
+    ASSERT_TRUE(root->getType() == JsonType::JSON_OBJECT);
+    ASSERT_EQUAL(root->size(), 5);
+    ASSERT_EQUAL(root->key(1), "long");
+    ASSERT_EQUAL(root->get("short")->asString(), "abc");
+    ASSERT_EQUAL((*root)["long"]->asString(), "a string longer than fourteen bytes");
+
+    const JsonValue *numbers = root->get("numbers");
+    ASSERT_EQUAL(numbers->size(), 5);
+    ASSERT_EQUAL(numbers->get(1)->asInt64(), INT64_MIN);
+    ASSERT_EQUAL(numbers->get(2)->asUint64(), UINT64_MAX);
+    ASSERT_EQUAL(numbers->get(3)->asNumber(), 2.5);
+    ASSERT_FALSE(numbers->get(4)->isInteger());
+    ASSERT_TRUE(numbers->get(5) == nullptr);
+
+    ASSERT_TRUE(root->get("flags")->get(0)->asBool());
+    ASSERT_FALSE(root->get("flags")->get(1)->asBool());
+    ASSERT_TRUE(root->get("flags")->get(2)->getType() == JsonType::JSON_NULL);
+    ASSERT_EQUAL(root->get("nested")->get("empty")->size(), 0);
+    ASSERT_TRUE(root->get("missing") == nullptr);
+
+    ASSERT_EQUAL(JsonPointer("/numbers/3").evaluate(root)->asNumber(), 2.5);
+    ASSERT_TRUE(JsonPointer("/nested/obj/x").evaluate(root) == nullptr);
+
+    JsonData *tree = JSON(text);
+    ASSERT_EQUAL(root->emit(), tree->emit());
+    delete tree;
+
+    // A repeated key finds its last value, as JSON() keeps it.
+    JsonCompactDocument duplicates = JSON_compact("{\"a\": 1, \"b\": {\"c\": 3, \"c\": 4}, \"a\": 2}");
+    ASSERT_EQUAL(duplicates.getRoot()->size(), 3);
+    ASSERT_EQUAL(duplicates.getRoot()->get("a")->asInt64(), 2);
+    ASSERT_EQUAL(JsonPointer("/b/c").evaluate(duplicates.getRoot())->asInt64(), 4);
+
+    JsonCompactDocument invalid = JSON_compact("[1, 2");
+    ASSERT_TRUE(invalid.hasError());
+    ASSERT_TRUE(invalid.getRoot() == nullptr);
+}
+
+TEST(json_tape)
+{
+    std::string text = "{\"name\": \"tape\", \"skip\": {\"deep\": [[1, 2], {\"x\": null}]}, "
+                       "\"numbers\": [-5, 18446744073709551615, 0.25], \"flags\": [true, false], \"empty\": {}}";
+    JsonTape tape = JSON_tape(text);
+
+    ASSERT_FALSE(tape.hasError());
+
+    JsonTapeRef root = tape.getRoot();
+    ASSERT_TRUE(root.getType() == JsonType::JSON_OBJECT);
+    ASSERT_EQUAL(root.size(), 5);
+    ASSERT_EQUAL(root["name"].asString(), "tape");
+    ASSERT_EQUAL(root["numbers"][0].asInt64(), -5);
+    ASSERT_EQUAL(root["numbers"][1].asUint64(), UINT64_MAX);
+    ASSERT_EQUAL(root["numbers"][2].asNumber(), 0.25);
+    ASSERT_FALSE(root["numbers"][2].isInteger());
+    ASSERT_TRUE(root["flags"][0].asBool());
+    ASSERT_TRUE(root["skip"]["deep"][1]["x"].getType() == JsonType::JSON_NULL);
+    ASSERT_EQUAL(root["empty"].size(), 0);
+    ASSERT_FALSE(root["missing"].isValid());
+    ASSERT_FALSE(root["numbers"][3].isValid());
+
+    // Skipping a container is one jump to the entry after its end.
+    JsonTapeRef skip = root["skip"];
+    ASSERT_TRUE(JsonTapeRef(&tape, skip.next()).getType() == JsonType::JSON_STRING);
+
+    std::string keys;
+    for (auto it = root.begin(); it != root.end(); ++it)
+        keys += std::string(it.key()) + ",";
+    ASSERT_EQUAL(keys, "name,skip,numbers,flags,empty,");
+
+    double sum = 0;
+    for (JsonTapeRef value : root["numbers"])
+        sum += value.asNumber();
+    ASSERT_EQUAL(sum, -5 + 18446744073709551615.0 + 0.25);
+
+    JsonData *tree = JSON(text);
+    ASSERT_EQUAL(root.emit(), tree->emit());
+    delete tree;
+
+    JsonTape invalid = JSON_tape("{\"a\": }");
+    ASSERT_TRUE(invalid.hasError());
+    ASSERT_FALSE(invalid.getRoot().isValid());
+}
+
+TEST(json_tape_duplicate_keys)
+{
+    // Lookups find the last value of a repeated key, as JSON() keeps it.
+    std::string text = "{\"a\":1,\"a\":2}";
+    JsonTape tape = JSON_tape(text);
+    JsonData *tree = JSON(text);
+
+    ASSERT_EQUAL(tape.getRoot()["a"].asInt64(), 2);
+    ASSERT_EQUAL(tape.getRoot()["a"].asInt64(), tree->get("a")->asInt64());
+    delete tree;
+
+    // The tape keeps every member as written; parsing its output back
+    // gives the same tree.
+    text = "{\"a\": [1, {\"b\": 2}], \"c\": 0.5, \"a\": {\"d\": [3], \"d\": [4, 5]}, \"e\": -1}";
+    tape = JSON_tape(text);
+    tree = JSON(text);
+    JsonData *emitted = JSON(tape.getRoot().emit());
+
+    ASSERT_EQUAL(tape.getRoot().size(), 4);
+    ASSERT_EQUAL(tape.getRoot()["a"]["d"][1].asInt64(), 5);
+    ASSERT_EQUAL(tape.getRoot()["e"].asInt64(), -1);
+    ASSERT_EQUAL(emitted->emit(), tree->emit());
+
+    delete emitted;
+    delete tree;
+}
+
+TEST(json_binary_dump_load)
+{
+    JsonData *tree = JSON("{\"config\": {\"threads\": 8, \"ratio\": 0.75, \"names\": [\"a\", \"a long name for the arena\"]}, "
+                          "\"enabled\": true, \"missing\": null, \"big\": 18446744073709551615, \"neg\": -3}");
+
+    std::string path = tempPath("json_test_binary.jsonb");
+    ASSERT_TRUE(JSON_dumpb(tree, path));
+
+    JsonTape tape = JSON_loadb(path);
+    ASSERT_FALSE(tape.hasError());
+
+    JsonTapeRef root = tape.getRoot();
+    ASSERT_EQUAL(root.emit(), tree->emit());
+    ASSERT_EQUAL(root["config"]["threads"].asInt64(), 8);
+    ASSERT_EQUAL(root["config"]["names"][1].asString(), "a long name for the arena");
+    ASSERT_EQUAL(root["big"].asUint64(), UINT64_MAX);
+    ASSERT_EQUAL(root["neg"].asInt64(), -3);
+
+    // A parsed tape saves to the same bytes as the tree it came from.
+    ASSERT_TRUE(JSON_dumpb(JSON_tape(tree->emit()), path));
+    ASSERT_EQUAL(JSON_loadb(path).getRoot().emit(), tree->emit());
+    delete tree;
+
+    {
+        std::ofstream file(path);
+        file << "{\"not\": \"binary\"}";
+    }
+    JsonTape invalid = JSON_loadb(path);
+    std::remove(path.c_str());
+    ASSERT_TRUE(invalid.getResult().error == JsonError::FILE_ERROR);
+    ASSERT_FALSE(invalid.getRoot().isValid());
+    ASSERT_TRUE(JSON_loadb("does_not_exist.jsonb").hasError());
+}
+
+TEST(json_max_depth)
+{
+    // Far deeper than the call stack could take with a recursive parser.
+    std::string deep = std::string(1000000, '[') + std::string(1000000, ']');
+    ParseResult result;
+
+    ASSERT_TRUE(JSON(deep, result) == nullptr);
+    ASSERT_TRUE(result.error == JsonError::DEPTH_EXCEEDED);
+    ASSERT_EQUAL(result.offset, JSON_MAX_DEPTH);
+
+    JsonParseOptions options;
+    options.maxDepth = 3;
+
+    JsonData *ok = JSON("{\"a\": [[1], {}]}", options, result);
+    ASSERT_TRUE(result.ok());
+    delete ok;
+
+    ASSERT_TRUE(JSON("{\"a\": [[[1]]]}", options, result) == nullptr);
+    ASSERT_TRUE(result.error == JsonError::DEPTH_EXCEEDED);
+    ASSERT_EQUAL(result.offset, 8);
+
+    SaxRecorder recorder;
+    ASSERT_FALSE(JSON_sax(deep, recorder, JsonParseOptions(), result));
+    ASSERT_TRUE(result.error == JsonError::DEPTH_EXCEEDED);
+
+    JsonPushParser parser([](JsonData *value) { delete value; }, options);
+    ASSERT_FALSE(parser.feed("[[[["));
+    ASSERT_TRUE(parser.getResult().error == JsonError::DEPTH_EXCEEDED);
+    ASSERT_EQUAL(parser.getResult().offset, 3);
+
+    options.maxDepth = 2000;
+    std::string nested = std::string(1500, '[') + std::string(1500, ']');
+    JsonData *value = JSON(nested, options, result);
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQUAL(value->emit(), nested);
+    delete value;
+}
+
+TEST(json_string_escapes)
+{
+    JsonData *value = JSON("{\"k\\u00e9y\": \"tab\\tquote\\\"slash\\/\\\\ \\u00e9 \\u20ac \\ud83d\\ude00 \\ud800x\"}");
+
+    ASSERT_TRUE(value != nullptr);
+    ASSERT_EQUAL(value->get("k\xc3\xa9y")->asString(),
+                 "tab\tquote\"slash/\\ \xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 \xef\xbf\xbdx");
+
+    // Output escapes only what JSON requires and parses back the same.
+    std::string emitted = value->emit();
+    ASSERT_EQUAL(emitted, "{\"k\xc3\xa9y\":\"tab\\tquote\\\"slash/\\\\ \xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 \xef\xbf\xbdx\"}");
+    JsonData *reparsed = JSON(emitted);
+    ASSERT_EQUAL(reparsed->emit(), emitted);
+    delete reparsed;
+    delete value;
+
+    JsonData *control = toJsonData(std::string("a\x01\n", 3));
+    ASSERT_EQUAL(control->emit(), "\"a\\u0001\\n\"");
+    delete control;
+
+    ParseResult result;
+    ASSERT_TRUE(JSON("[\"ok\", \"bad \\x escape\"]", result) == nullptr);
+    ASSERT_TRUE(result.error == JsonError::INVALID_STRING);
+    ASSERT_EQUAL(result.offset, 12);
+    ASSERT_TRUE(JSON("\"\\u12g4\"", result) == nullptr);
+    ASSERT_TRUE(result.error == JsonError::INVALID_STRING);
+
+    ASSERT_EQUAL(JSON_tape("[\"\\u00e9\\n\"]").getRoot().emit(), "[\"\xc3\xa9\\n\"]");
+}
+
+TEST(json_utf8_validation)
+{
+    std::string valid = "{\"caf\xc3\xa9\": \"\xe2\x82\xac \xf0\x9f\x98\x80 " + std::string(100, 'a') + "\"}";
+    JsonParseOptions options;
+    options.validateUtf8 = true;
+    ParseResult result;
+
+    JsonData *value = JSON(valid, options, result);
+    ASSERT_TRUE(result.ok());
+    delete value;
+
+    // Truncated, overlong, surrogate, past U+10FFFF and stray continuation.
+    const char *invalid[] = {"\xe2\x82", "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\x80", "\xff"};
+    for (const char *bytes : invalid)
+    {
+        std::string text = "[\"ok\", \"" + std::string(40, 'x') + bytes + "\"]";
+        ASSERT_TRUE(findInvalidUtf8(text.data(), text.data() + text.size()) == text.data() + 48);
+        ASSERT_TRUE(JSON(text, options, result) == nullptr);
+        ASSERT_TRUE(result.error == JsonError::INVALID_UTF8);
+        ASSERT_EQUAL(result.offset, 48);
+    }
+
+    // Multibyte text spanning several vectors, with escapes next to it.
+    std::string text;
+    for (int i = 0; i < 20; i++)
+        text += "\xe6\x97\xa5\\n\xd0\xbf\xf0\x9f\x98\x80\\\"";
+    value = JSON("\"" + text + "\"", options, result);
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQUAL(value->asString().size(), 20 * 11);
+    delete value;
+    ASSERT_TRUE(JSON("\"" + text + "\xe6\x97" + text + "\"", options, result) == nullptr);
+    ASSERT_EQUAL(result.offset, 1 + text.size());
+
+    // Off by default, and keys are checked as well.
+    std::string badKey = "{\"k\xc0\": 1}";
+    value = JSON(badKey, result);
+    ASSERT_TRUE(result.ok());
+    delete value;
+    ASSERT_TRUE(JSON(badKey, options, result) == nullptr);
+    ASSERT_TRUE(result.error == JsonError::INVALID_UTF8);
+    ASSERT_EQUAL(result.offset, 3);
+
+    SaxRecorder recorder;
+    ASSERT_FALSE(JSON_sax(badKey, recorder, options, result));
+    ASSERT_TRUE(result.error == JsonError::INVALID_UTF8);
+
+    JsonPushParser parser([](JsonData *value) { delete value; }, options);
+    ASSERT_FALSE(parser.feed("[1, \"ab\xe2\x82\"]"));
+    ASSERT_TRUE(parser.getResult().error == JsonError::INVALID_UTF8);
+    ASSERT_EQUAL(parser.getResult().offset, 7);
+}
+
 TEST(json_create_object){
     auto value = new JsonObject();
 
@@ -350,4 +1318,144 @@ TEST(json_push_pop){
 
 }
 
+TEST(json_owning_handle)
+{
+    Json value(JSON("{\"a\": [1, 2], \"b\": \"x\"}"));
+    ASSERT_TRUE(value.get() != nullptr);
+
+    Json moved = std::move(value);
+    ASSERT_TRUE(value.get() == nullptr);
+    ASSERT_EQUAL(moved->get("b")->asString(), "x");
+
+    // Replaced members and elements are freed by the container.
+    moved->set("b", toJsonData(1));
+    moved->set("b", Json(toJsonData("y")));
+    ASSERT_TRUE(moved->get("a")->push(Json(toJsonData(3))));
+    ASSERT_TRUE(moved->get("a")->set(0, Json(toJsonData(false))) != nullptr);
+
+    Json outOfRange(toJsonData(4));
+    ASSERT_TRUE(moved->get("a")->set(5, std::move(outOfRange)) == nullptr);
+    ASSERT_TRUE(outOfRange.get() != nullptr);
+    ASSERT_FALSE(moved->get("b")->push(std::move(outOfRange)));
+    ASSERT_TRUE(outOfRange.get() != nullptr);
+
+    ASSERT_EQUAL(moved->emit(), "{\"a\":[false,2,3],\"b\":\"y\"}");
+
+    Json last = moved->get("a")->take();
+    ASSERT_EQUAL(last->asInt64(), 3);
+    ASSERT_EQUAL(moved->get("a")->size(), 2);
+    moved->get("a")->take();
+    moved->get("a")->take();
+    ASSERT_TRUE(moved->get("a")->take().get() == nullptr);
+
+    // Duplicate keys keep the last value without leaking the others.
+    Json duplicates(JSON("{\"k\": [1], \"k\": {\"x\": 1}, \"k\": 2}"));
+    ASSERT_EQUAL(duplicates->emit(), "{\"k\":2}");
+
+    JsonDocument doc;
+    JsonData *root = doc.parse("{\"k\": [1]}");
+    root->set("k", toJsonData(2));
+    ASSERT_EQUAL(root->emit(), "{\"k\":2}");
+    delete root->get("k");
+}
+
+TEST(json_document_parse)
+{
+    JsonDocument doc;
+    JsonData *value = doc.parse("{\"name\":\"hello world\", \"ids\": [1, 2, 3], \"address\": {\"city\": \"beijing\"}}");
+
+    ASSERT_EQUAL(value->getType(), JsonType::JSON_OBJECT);
+    ASSERT_EQUAL(value->size(), 3);
+    ASSERT_EQUAL(value->get("name")->asString(), "hello world");
+    ASSERT_EQUAL(value->get("ids")->asArray()->size(), 3);
+    ASSERT_EQUAL(value->get("ids")->get(2)->asNumber(), 3);
+    ASSERT_EQUAL(value->get("address")->get("city")->asString(), "beijing");
+    ASSERT_TRUE(value->get("missing") == nullptr);
+
+    JsonDocument moved(std::move(doc));
+    ASSERT_TRUE(moved.getRoot() == value);
+    ASSERT_EQUAL(moved.getRoot()->get("name")->asString(), "hello world");
+}
+
+TEST(json_document_reparse)
+{
+    JsonDocument doc;
+    doc.parse("[1, 2, 3]");
+    JsonData *value = doc.parse("[\"a\", [\"b\"]]");
+
+    ASSERT_EQUAL(value->size(), 2);
+    ASSERT_EQUAL(value->get(1)->get(0)->asString(), "b");
+    ASSERT_EQUAL(JSON_emit(value), "[\"a\",[\"b\"]]");
+}
+
+TEST(json_zero_copy_strings)
+{
+    std::string str = "{\"plain\": \"hello world\", \"escaped\": \"a\\\"b\"}";
+    JsonParseOptions options;
+    options.zeroCopy = true;
+
+    JsonData *value = JSON(std::string_view(str), options);
+
+    std::string_view plain = value->get("plain")->asStringView();
+    ASSERT_EQUAL(plain, "hello world");
+    ASSERT_TRUE(plain.data() >= str.data() && plain.data() < str.data() + str.size());
+
+    std::string_view escaped = value->get("escaped")->asStringView();
+    ASSERT_EQUAL(escaped, "a\"b");
+    ASSERT_TRUE(escaped.data() < str.data() || escaped.data() >= str.data() + str.size());
+
+    delete value;
+}
+
+TEST(json_string_view_entry_point)
+{
+    std::string str = "[\"a\", \"b\"] trailing";
+    JsonData *value = JSON(std::string_view(str.data(), 10));
+
+    ASSERT_EQUAL(value->size(), 2);
+    ASSERT_EQUAL(value->get(1)->asString(), "b");
+
+    delete value;
+}
+
+TEST(structural_index_positions)
+{
+    std::string str = "{\"a\\\"}\": [1, true],\n \"b\": null}";
+    std::vector<uint32_t> index;
+
+    ASSERT_TRUE(buildStructuralIndex(str.data(), str.size(), index));
+
+    std::vector<uint32_t> expected = {0, 1, 7, 9, 10, 11, 13, 17, 18, 21, 24, 26, 30};
+    ASSERT_SEQUENCE_EQUAL(index, expected);
+
+    std::string quoted = "{'a': 1}";
+    ASSERT_FALSE(buildStructuralIndex(quoted.data(), quoted.size(), index));
+}
+
+TEST(structural_index_parse_matches_scalar)
+{
+    std::string str = "{\"items\": [";
+    for (int i = 0; i < 200; i++)
+    {
+        if (i)
+            str += ",\n    ";
+        str += "{\"id\": " + std::to_string(i) + ", \"name\": \"item \\\"" + std::to_string(i) + "\\\" {[,:]}\", \"ok\": true}";
+    }
+    str += "], \"tail\" :\t null }";
+
+    StringBuffer buffer(str);
+    ASSERT_TRUE(buffer.buildIndex());
+
+    JsonData *a = parseToJsonData(buffer);
+    JsonData *b = JSON(str);
+
+    ASSERT_FALSE(hasError());
+    ASSERT_EQUAL(a->get("items")->size(), 200);
+    ASSERT_EQUAL(a->get("items")->get(199)->get("name")->asString(), "item \"199\" {[,:]}");
+    ASSERT_EQUAL(a->emit(), b->emit());
+
+    delete a;
+    delete b;
+}
+
 TEST_MAIN()
\ No newline at end of file